@@ -3,37 +3,98 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <queue>
-#include <map>
 #include <string>
+#include <cstring>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+
+//codec y formato .cpm compartidos con otros programas (proyecto libcpm)
+#include "cpm.h"
+
+//en linux los archivos grandes se leen y escriben proyectados en memoria (mmap)
+#if defined(__linux__)
+#define CPM_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//pico de memoria para --stats
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#elif defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+//en windows la entrada y salida estandar se pasan a modo binario para usarlas en tuberias
+#if defined(_WIN32)
+#include <cstdio>
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+//recorrido de carpetas al empaquetar y creacion de carpetas al extraer
+#if defined(_WIN32)
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
 
 using namespace std;
 
-bool decompressFile(const string& cpmPath);
+bool decompressFile(const string& cpmPath, int threads, const string& outputPath);
+bool extractArchive(const string& cpaPath, const string& miembro, const string& destinoPath, int threads, bool verificar);
 
-//estructura principal del arbol de huffman
-struct HuffmanNodo {
-    //contador acumulado que indica cuantas veces aparece el simbolo asociado
-    unsigned long long frecuencia;
-    //identificador del byte almacenado en este nodo, -1 para nodos internos
-    int byteGuardado;
-    //puntero que apunta al hijo izquierdo, asociado al bit 0 en el recorrido
-    HuffmanNodo* izquierda;
-    //puntero que apunta al hijo derecho, asociado al bit 1 en el recorrido
-    HuffmanNodo* derecha;
+//estadisticas de la operacion en curso cuando se pide --stats, NULL en otro caso
+//con NULL ninguna etapa lee el reloj; los hilos miden en un CodecStats propio y lo suman aca con statsMutex
+CodecStats* statsActivas = NULL;
+mutex statsMutex;
 
-    HuffmanNodo(unsigned long long f, int b, HuffmanNodo* izq = NULL, HuffmanNodo* der = NULL)
-        : frecuencia(f), byteGuardado(b), izquierda(izq), derecha(der) {
-    }
-};
+//diccionario indicado con --dict, NULL si no hay; sus tablas se arman una vez al cargarlo y todos
+//los hilos las comparten sin modificarlas
+const Dictionary* diccionarioActivo = NULL;
 
-//comparador para ordenar la cola segun la frecuencia mas baja primero
-struct CompararHuffman {
-    bool operator()(HuffmanNodo* a, HuffmanNodo* b) const {
-        //retorna true cuando a tiene mayor frecuencia para que la cola priorice el elemento mas chico primero
-        return a->frecuencia > b->frecuencia;
-    }
-};
+//suma lo medido por un hilo a las estadisticas de la operacion
+void mergeStats(const CodecStats& parcial) {
+    if (!statsActivas) return;
+    lock_guard<mutex> lock(statsMutex);
+    statsActivas->add(parcial);
+}
+
+//archivo de varios miembros (.cpa): una carpeta completa en un solo contenedor
+//header     : magic(4) version(1) flags(1) reservado(2) tamanoBloque(4)
+//datos      : los bloques de cada miembro uno detras del otro, con el formato de bloque v2 y sin cierre
+//directorio : cantidadTablas(4) y las longitudes de cada tabla compartida (mismo formato que en un bloque),
+//             cantidadMiembros(4) y por miembro largoNombre(4) nombre tamanoOriginal(8) posicion(8)
+//             tamanoComprimido(8) tabla(4)
+//pie        : posicionDirectorio(8) tamanoDirectorio(4) crc32c del directorio(4) magic del directorio(4)
+//los archivos chicos se agrupan en lotes que comparten una tabla de codigos guardada una sola vez en el
+//directorio; sus bloques usan el modo BLOQUE_TABLA_EXTERNA y cada miembro se extrae sin tocar los demas
+const unsigned char CPA_MAGIC[4] = { 'H', 'C', 'P', 'A' };
+const unsigned char CPA_VERSION = 1;
+const size_t CPA_HEADER_SIZE = 12;
+const unsigned char CPA_DIRECTORY_MAGIC[4] = { 'H', 'C', 'P', 'D' };
+const size_t CPA_FOOTER_SIZE = 20;
+//miembro cuyos bloques no usan tabla compartida
+const unsigned int CPA_SIN_TABLA = 0xFFFFFFFFu;
+//hasta este tamano un archivo se agrupa con otros y comparte con ellos su tabla de codigos
+const unsigned long long CPA_ARCHIVO_CHICO = 64 * 1024;
+//bytes originales que reune como maximo un lote de archivos chicos
+const unsigned long long CPA_LOTE = CPM_BLOCK_SIZE;
 
 //obtiene carpeta base de una ruta simple
 string getDirectory(const string& path) {
@@ -121,275 +182,702 @@ bool writeFile(const string& path, const vector<unsigned char>& buffer) {
     return true;
 }
 
-//crea el arbol de huffman usando cola prioritaria
-HuffmanNodo* buildHuffmanTree(const unsigned long long freqs[256]) {
-    //cola de prioridad que entrega siempre el nodo con menor frecuencia
-    priority_queue<HuffmanNodo*, vector<HuffmanNodo*>, CompararHuffman> colaHuffman;
+//archivo de solo lectura proyectado en memoria
+//el contenido se lee directo de las paginas del sistema, sin copiarlo a un buffer propio
+//open devuelve false si el sistema no permite proyectar el archivo, y quien llama usa flujos normales
+class MappedFile {
+public:
+    MappedFile() : datos(NULL), tamano(0) {
+    }
+
+    ~MappedFile() {
+        close();
+    }
 
-    for (int i = 0; i < 256; ++i) {
-        //cada simbolo con frecuencia positiva se convierte en un nodo hoja
-        if (freqs[i] > 0) {
-            colaHuffman.push(new HuffmanNodo(freqs[i], i));
+    //secuencial avisa al sistema que el archivo se recorre de principio a fin,
+    //asi adelanta la lectura y libera antes las paginas ya usadas
+    bool open(const string& path, bool secuencial) {
+        close();
+#if defined(CPM_MMAP)
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (unsigned long long)info.st_size > (size_t)-1) {
+            ::close(fd);
+            return false;
+        }
+        tamano = (size_t)info.st_size;
+        //un archivo vacio no se puede proyectar, pero se representa igual sin datos
+        if (tamano > 0) {
+            void* mapa = mmap(NULL, tamano, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapa == MAP_FAILED) {
+                ::close(fd);
+                tamano = 0;
+                return false;
+            }
+            datos = (const unsigned char*)mapa;
+            madvise(mapa, tamano, secuencial ? MADV_SEQUENTIAL : MADV_WILLNEED);
         }
+        //la proyeccion sigue valida despues de cerrar el descriptor
+        ::close(fd);
+        return true;
+#else
+        (void)path;
+        (void)secuencial;
+        return false;
+#endif
     }
 
-    if (colaHuffman.empty()) return NULL;
+    void close() {
+#if defined(CPM_MMAP)
+        if (datos) munmap((void*)datos, tamano);
+#endif
+        datos = NULL;
+        tamano = 0;
+    }
+
+    const unsigned char* data() const {
+        return datos;
+    }
 
-    //caso especial con un simbolo
-    if (colaHuffman.size() == 1) {
-        HuffmanNodo* unico = colaHuffman.top();
-        colaHuffman.pop();
-        //se crea un nodo padre artificial para conservar la logica de recorridos binarios
-        HuffmanNodo* raiz = new HuffmanNodo(unico->frecuencia, -1, unico, NULL);
-        return raiz;
+    size_t size() const {
+        return tamano;
     }
 
-    while (colaHuffman.size() > 1) {
-        //extrae dos nodos con menor frecuencia para combinarlos en un nuevo padre
-        HuffmanNodo* primero = colaHuffman.top();
-        colaHuffman.pop();
-        HuffmanNodo* segundo = colaHuffman.top();
-        colaHuffman.pop();
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const unsigned char* datos;
+    size_t tamano;
+};
 
-        //el nuevo padre guarda la suma de frecuencias para mantener la codificacion optima
-        HuffmanNodo* padre = new HuffmanNodo(primero->frecuencia + segundo->frecuencia, -1, primero, segundo);
-        colaHuffman.push(padre);
+//archivo de salida creado con su tamano final y proyectado en memoria para escritura
+//el espacio se reserva de una vez en el disco (fallocate) y cada hilo escribe directo en su tramo
+//create devuelve false si el sistema no permite proyectar el archivo, y quien llama usa flujos normales
+class MappedOutput {
+public:
+    MappedOutput() : datos(NULL), tamano(0), fd(-1) {
     }
 
-    return colaHuffman.top();
-}
+    ~MappedOutput() {
+        close();
+    }
 
-//recorre el arbol para asignar codigos
-void buildCodes(HuffmanNodo* nodo, const string& prefix, vector<string>& codes) {
-    if (!nodo) return;
+    bool create(const string& path, unsigned long long size) {
+        close();
+#if defined(CPM_MMAP)
+        if (size == 0 || size > (size_t)-1) return false;
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) return false;
+        //si el sistema de archivos no permite reservar se extiende el archivo sin reservar bloques
+        if (posix_fallocate(fd, 0, (off_t)size) != 0 && ftruncate(fd, (off_t)size) != 0) {
+            close();
+            return false;
+        }
+        void* mapa = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapa == MAP_FAILED) {
+            close();
+            return false;
+        }
+        datos = (unsigned char*)mapa;
+        tamano = (size_t)size;
+        madvise(mapa, tamano, MADV_SEQUENTIAL);
+        return true;
+#else
+        (void)path;
+        (void)size;
+        return false;
+#endif
+    }
 
-    //se usa recorrido en profundidad acumulando el prefijo de bits hasta llegar a cada hoja
+    //libera la proyeccion; las paginas escritas quedan en el archivo aunque no se llame a close
+    void close() {
+#if defined(CPM_MMAP)
+        if (datos) munmap(datos, tamano);
+        if (fd >= 0) ::close(fd);
+#endif
+        datos = NULL;
+        tamano = 0;
+        fd = -1;
+    }
 
-    //hoja del arbol
-    if (!nodo->izquierda && !nodo->derecha && nodo->byteGuardado >= 0) {
-        codes[nodo->byteGuardado] = prefix.empty() ? "0" : prefix;
-        return;
+    unsigned char* data() const {
+        return datos;
     }
 
-    //el hijo izquierdo representa un cero, por eso se concatena '0' al prefijo acumulado
-    buildCodes(nodo->izquierda, prefix + "0", codes);
-    //el hijo derecho representa un uno, se concatena '1' manteniendo la propiedad del arbol
-    buildCodes(nodo->derecha, prefix + "1", codes);
+private:
+    MappedOutput(const MappedOutput&);
+    MappedOutput& operator=(const MappedOutput&);
+
+    unsigned char* datos;
+    size_t tamano;
+    int fd;
+};
+
+//lee la tabla de codigos del formato v1: cantidad, y por cada codigo su simbolo, longitud y bits en texto
+bool readCodeTable(const vector<unsigned char>& data, size_t& offset, vector<string>& codes) {
+    if (offset + sizeof(unsigned int) > data.size()) return false;
+    unsigned int numCodes = readUInt(data, offset);
+
+    for (unsigned int i = 0; i < numCodes; ++i) {
+        //recupera cada simbolo y longitud para reconstruir la tabla de codigos
+        if (offset + 1 > data.size()) return false;
+        unsigned char symbol = data[offset];
+        offset += 1;
+
+        if (offset + sizeof(unsigned int) > data.size()) return false;
+        unsigned int len = readUInt(data, offset);
+
+        if (len > data.size() - offset) return false;
+        //se reconstruye el codigo literal concatenando exactamente len caracteres
+        string code((const char*)&data[offset], len);
+        offset += len;
+
+        codes[symbol] = code;
+    }
+    return true;
 }
 
-//convierte la cadena de bits en bytes reales usando desplazamientos y or
-vector<unsigned char> bitsToBytes(const string& bits, int& paddedBits) {
-    //esta rutina empaqueta la cadena de caracteres '0' y '1' en bytes fisicos usando corrimientos y or bit a bit
-    //se calcula la cantidad de bits de relleno para ajustar a multiplos de 8
-    paddedBits = 0;
-    if (bits.empty()) return vector<unsigned char>();
+//lee el header del formato original (v1) y arma las tablas de codigos
+//el formato v1 ya no se escribe, pero se sigue aceptando para abrir archivos antiguos
+bool readHeader(const vector<unsigned char>& fileData,
+    size_t& offset,
+    vector<string>& codes,
+    int& paddedBits,
+    unsigned long long& originalSize,
+    string& originalName) {
+    if (fileData.size() < 8) return false;
+
+    if (offset + sizeof(int) > fileData.size()) return false;
+    //el entero inicial define cuantos bits finales deben ignorarse al reconstruir el flujo
+    paddedBits = (int)readUInt(fileData, offset);
 
-    int totalBits = (int)bits.size();
-    paddedBits = (8 - (totalBits % 8)) % 8;
+    if (!readCodeTable(fileData, offset, codes)) return false;
 
-    string bitstream = bits;
-    //agrega ceros a la derecha para completar el ultimo byte
-    bitstream.append(paddedBits, '0');
+    if (offset + sizeof(unsigned long long) > fileData.size()) return false;
+    //se obtiene el valor original de size para saber hasta donde leer los bytes reconstruidos
+    originalSize = readULL(fileData, offset);
 
-    int finalBits = (int)bitstream.size();
-    vector<unsigned char> out(finalBits / 8, 0);
+    if (offset + sizeof(unsigned int) > fileData.size()) return false;
+    unsigned int nameLen = readUInt(fileData, offset);
 
-    int bitIndex = 0;
-    for (size_t i = 0; i < out.size(); ++i) {
-        //inicializa el byte actual en cero para componerlo bit a bit
-        unsigned char byteActual = 0;
+    if (offset + nameLen > fileData.size()) return false;
+    originalName.assign((const char*)&fileData[offset], nameLen);
+    offset += nameLen;
 
-        for (int b = 0; b < 8; ++b) {
-            //desplaza a la izquierda para dejar espacio al bit nuevo
-            byteActual = (unsigned char)(byteActual << 1);
+    return true;
+}
 
-            if (bitstream[bitIndex++] == '1') {
-                //or con 1 prende el bit menos significativo
-                byteActual = (unsigned char)(byteActual | 1);
-            }
-        }
-        out[i] = byteActual;
+//tamano del primer tramo que reserva readExact
+const size_t LECTURA_TRAMO = 1 << 20;
+
+//lee exactamente size bytes del flujo, falla si el archivo termina antes
+//el buffer crece por tramos a medida que llegan los datos, asi un tamano danado no reserva memoria de mas
+bool readExact(istream& in, vector<unsigned char>& buffer, size_t size) {
+    buffer.resize(min(size, LECTURA_TRAMO));
+    size_t leidos = 0;
+    while (leidos < size) {
+        in.read((char*)&buffer[leidos], (streamsize)(buffer.size() - leidos));
+        leidos += (size_t)in.gcount();
+        if (leidos < buffer.size()) return false;
+        buffer.resize(leidos + min(size - leidos, leidos));
+    }
+    return true;
+}
+
+//bytes que quedan desde la posicion actual del flujo; sin limite si no se puede saber (entrada estandar)
+unsigned long long remainingBytes(istream& in) {
+    streampos actual = in.tellg();
+    if (actual == streampos(-1)) return ~0ULL;
+    in.seekg(0, ios::end);
+    streampos fin = in.tellg();
+    in.seekg(actual);
+    if (fin == streampos(-1) || !in) {
+        in.clear();
+        in.seekg(actual);
+        return ~0ULL;
     }
+    return fin > actual ? (unsigned long long)(fin - actual) : 0;
+}
 
-    return out;
+//un tamano codificado posible para un bloque de rawSize bytes; se controla antes de reservar memoria para leerlo
+bool validEncodedSize(unsigned int rawSize, unsigned long long encodedSize) {
+    return encodedSize <= (unsigned long long)rawSize + CPM_MAX_BLOCK_OVERHEAD;
 }
 
-//pasa cada byte a texto de bits usando mascaras
-string bytesToBits(const vector<unsigned char>& data) {
-    //convierte cada byte comprimido a su representacion textual de bits para lectura secuencial
-    string bits;
-    bits.reserve(data.size() * 8);
+//lee el header v2 completo, se asume que el magic ya fue verificado y consumido
+bool readFileHeader(istream& in, CpmHeader& header) {
+    vector<unsigned char> fijo;
+    if (!readExact(in, fijo, CPM_HEADER_SIZE - 4)) return false;
 
-    for (size_t i = 0; i < data.size(); ++i) {
-        unsigned char byte = data[i];
-        for (int b = 7; b >= 0; --b) {
-            //mascara con desplazamiento para revisar cada posicion
-            unsigned char mask = (unsigned char)(1 << b);
-            //se usa and bit a bit para aislar el bit objetivo antes de convertirlo a caracter
-            bits.push_back((byte & mask) ? '1' : '0');
-        }
+    size_t offset = 0;
+    header.version = fijo[offset++];
+    header.flags = fijo[offset++];
+    offset += 2;
+    header.blockSize = readUInt(fijo, offset);
+    unsigned int nameLen = readUInt(fijo, offset);
+
+    if (header.version != CPM_VERSION || header.blockSize == 0 || header.blockSize > CPM_MAX_BLOCK_SIZE ||
+        (header.flags & ~CPM_FLAGS_CONOCIDOS) != 0) {
+        return false;
+    }
+
+    vector<unsigned char> nombre;
+    if (!readExact(in, nombre, nameLen)) return false;
+    header.originalName.assign(nombre.begin(), nombre.end());
+
+    header.diccionario = 0;
+    if (header.flags & CPM_FLAG_DICCIONARIO) {
+        vector<unsigned char> id;
+        if (!readExact(in, id, 4)) return false;
+        size_t offset = 0;
+        header.diccionario = readUInt(id, offset);
     }
+    return true;
+}
 
-    return bits;
+//posicion del primer bloque, despues del header completo
+unsigned long long headerSize(const CpmHeader& header) {
+    return CPM_HEADER_SIZE + header.originalName.size() + ((header.flags & CPM_FLAG_DICCIONARIO) ? 4 : 0);
 }
 
-//lee un entero de 4 bytes desde el buffer
-unsigned int readUInt(const vector<unsigned char>& data, size_t& offset) {
-    if (offset + 4 > data.size()) return 0;
-    //se reconstruye el entero en formato little endian aplicando corrimientos de 8 bits
-    unsigned int value = 0;
-    for (int i = 0; i < 4; ++i) {
-        //cada byte se desplaza segun su peso y se combina con or para reconstruir el entero
-        value |= ((unsigned int)data[offset + i]) << (8 * i);
+//id de un diccionario como 8 digitos hexadecimales, la forma en que se muestra al usuario
+string dictionaryName(unsigned int id) {
+    const char* digitos = "0123456789abcdef";
+    string nombre(8, '0');
+    for (int i = 7; i >= 0; --i, id >>= 4) {
+        nombre[i] = digitos[id & 15];
     }
-    offset += 4;
-    return value;
+    return nombre;
 }
 
-//lee un entero de 8 bytes usando desplazamientos
-unsigned long long readULL(const vector<unsigned char>& data, size_t& offset) {
-    if (offset + 8 > data.size()) return 0;
-    //la logica replica el proceso anterior pero ampliando a 64 bits para manejar valores grandes
-    unsigned long long value = 0;
-    for (int i = 0; i < 8; ++i) {
-        //se aprovechan corrimientos de 8 bits para ubicar cada byte en su posicion correcta
-        value |= ((unsigned long long)data[offset + i]) << (8 * i);
+//un .cpm comprimido con diccionario solo se puede leer con ese mismo diccionario
+bool checkDictionary(const CpmHeader& header) {
+    if (!(header.flags & CPM_FLAG_DICCIONARIO)) return true;
+    if (!diccionarioActivo) {
+        cerr << "El archivo se comprimio con el diccionario " << dictionaryName(header.diccionario) << ", indiquelo con --dict.\n";
+        return false;
+    }
+    if (diccionarioActivo->id != header.diccionario) {
+        cerr << "El archivo se comprimio con el diccionario " << dictionaryName(header.diccionario) << " y se indico el "
+             << dictionaryName(diccionarioActivo->id) << ".\n";
+        return false;
     }
-    offset += 8;
-    return value;
+    return true;
 }
 
-//escribe el header completo con informacion adicional
-void writeHeader(ofstream& out,
-    const vector<string>& codes,
-    int paddedBits,
-    unsigned long long originalSize,
-    const string& originalName) {
-    //guarda primero los bits de relleno para reconstruir el ultimo byte
-    int pad = paddedBits;
-    //el valor de relleno permite saber cuantos bits invalidos descartar durante la lectura
-    out.write((const char*)&pad, sizeof(int));
+//tabla ya armada para los bloques de modo 5 de un .cpm con diccionario, NULL sin diccionario
+const HuffmanDecoder* dictionaryTable(const CpmHeader& header) {
+    return (header.flags & CPM_FLAG_DICCIONARIO) && diccionarioActivo ? &diccionarioActivo->decoder : NULL;
+}
 
-    unsigned int numCodes = 0;
-    for (size_t i = 0; i < codes.size(); ++i) {
-        if (!codes[i].empty()) numCodes++;
-    }
-    out.write((const char*)&numCodes, sizeof(unsigned int));
+//busca el indice al final del archivo y valida que cada bloque caiga dentro de la zona de datos
+//devuelve false si el archivo no tiene indice (por ejemplo si se creo sin el) o si es inconsistente
+bool readBlockIndex(istream& in, const CpmHeader& header, unsigned long long dataStart, vector<BlockIndexEntry>& indice) {
+    in.clear();
+    in.seekg(0, ios::end);
+    long long fileSize = (long long)in.tellg();
+    if (fileSize < (long long)(dataStart + CPM_FOOTER_SIZE)) return false;
 
-    for (int i = 0; i < 256; ++i) {
-        if (codes[i].empty()) continue;
+    vector<unsigned char> pie;
+    in.seekg(fileSize - (long long)CPM_FOOTER_SIZE, ios::beg);
+    if (!readExact(in, pie, CPM_FOOTER_SIZE)) return false;
+    if (memcmp(&pie[12], CPM_INDEX_MAGIC, 4) != 0) return false;
 
-        unsigned char symbol = (unsigned char)i;
-        unsigned int len = (unsigned int)codes[i].size();
+    size_t offset = 0;
+    unsigned long long indexOffset = readULL(pie, offset);
+    unsigned int cantidad = readUInt(pie, offset);
+    if (indexOffset < dataStart ||
+        indexOffset + (unsigned long long)cantidad * CPM_INDEX_ENTRY_SIZE + CPM_FOOTER_SIZE != (unsigned long long)fileSize) {
+        return false;
+    }
 
-        //se serializa el simbolo seguido de la longitud y la cadena de bits sin separadores
-        out.write((const char*)&symbol, sizeof(unsigned char));
-        out.write((const char*)&len, sizeof(unsigned int));
-        out.write(codes[i].data(), (streamsize)len);
+    vector<unsigned char> datos;
+    in.seekg((long long)indexOffset, ios::beg);
+    if (!readExact(in, datos, (size_t)cantidad * CPM_INDEX_ENTRY_SIZE)) return false;
+
+    indice.resize(cantidad);
+    offset = 0;
+    for (unsigned int i = 0; i < cantidad; ++i) {
+        BlockIndexEntry& entrada = indice[i];
+        entrada.offset = readULL(datos, offset);
+        entrada.compressedSize = readUInt(datos, offset);
+        entrada.rawSize = readUInt(datos, offset);
+        if (entrada.offset < dataStart || entrada.compressedSize < 8 ||
+            entrada.offset + entrada.compressedSize > indexOffset ||
+            entrada.rawSize == 0 || entrada.rawSize > header.blockSize ||
+            !validEncodedSize(entrada.rawSize, entrada.compressedSize - 8)) {
+            return false;
+        }
     }
+    return true;
+}
+
+//lee el prefijo de tamanos de un bloque de datos y su parte codificada desde la posicion actual del flujo
+//devuelve false si el bloque esta incompleto, si su tamano codificado es imposible o si en esa posicion esta el cierre
+bool readBlock(istream& in, const CpmHeader& header, vector<unsigned char>& prefijo,
+    vector<unsigned char>& codificado, unsigned int& rawSize) {
+    if (!readExact(in, prefijo, 8)) return false;
+    size_t offset = 0;
+    rawSize = readUInt(prefijo, offset);
+    unsigned int encodedSize = readUInt(prefijo, offset);
+    if (rawSize == 0 || rawSize > header.blockSize) return false;
+    if (!validEncodedSize(rawSize, encodedSize) || encodedSize > remainingBytes(in)) return false;
+    return readExact(in, codificado, encodedSize);
+}
 
-    out.write((const char*)&originalSize, sizeof(unsigned long long));
+//bloque que no tiene de donde sacar la tabla vigente
+const size_t SIN_FUENTE = (size_t)-1;
+
+//modo de un bloque (primer byte de su parte codificada) sin leer el resto; 0xFF si no se puede leer
+unsigned char readBlockMode(istream& in, const MappedFile* entrada, const BlockIndexEntry& bloque) {
+    if (bloque.compressedSize <= 8) return 0xFF;
+    unsigned long long posicion = bloque.offset + 8;
+    if (entrada) return posicion < entrada->size() ? entrada->data()[posicion] : 0xFF;
+    in.clear();
+    in.seekg((streamoff)posicion, ios::beg);
+    int modo = in.get();
+    return modo == EOF ? 0xFF : (unsigned char)modo;
+}
 
-    unsigned int nameLen = (unsigned int)originalName.size();
-    out.write((const char*)&nameLen, sizeof(unsigned int));
-    if (nameLen > 0) {
-        out.write(originalName.data(), (streamsize)nameLen);
+//con CPM_FLAG_TABLA_VIGENTE cada bloque de modo 5 usa la tabla del ultimo bloque de modo 6 anterior;
+//fuente recibe ese bloque para cada posicion del indice (el mismo si es de modo 6, SIN_FUENTE si no hay)
+void findTableSources(istream& in, const MappedFile* entrada, const vector<BlockIndexEntry>& indice, vector<size_t>& fuente) {
+    fuente.assign(indice.size(), SIN_FUENTE);
+    size_t ultima = SIN_FUENTE;
+    for (size_t i = 0; i < indice.size(); ++i) {
+        if (readBlockMode(in, entrada, indice[i]) == BLOQUE_TABLA_NUEVA) ultima = i;
+        fuente[i] = ultima;
     }
 }
 
-//lee el header y arma las tablas de codigos
-bool readHeader(const vector<unsigned char>& fileData,
-    size_t& offset,
-    vector<string>& codes,
-    int& paddedBits,
-    unsigned long long& originalSize,
-    string& originalName) {
-    if (fileData.size() < 8) return false;
+//deja vigente en decoder la tabla del bloque de modo 6 bloque, para decodificar los que lo siguen
+//sin pasar por los intermedios
+bool loadTableSource(istream& in,
+    const MappedFile* entrada,
+    const CpmHeader& header,
+    const BlockIndexEntry& bloque,
+    vector<unsigned char>& prefijo,
+    vector<unsigned char>& codificado,
+    BlockDecoder& decoder) {
+    decoder.tablaExterna = NULL;
+    if (entrada) {
+        if (bloque.compressedSize < 8 || bloque.offset > entrada->size() || bloque.compressedSize > entrada->size() - bloque.offset) {
+            return false;
+        }
+        return loadBlockTable(entrada->data() + bloque.offset + 8, bloque.compressedSize - 8, decoder);
+    }
+    unsigned int rawSize = 0;
+    in.clear();
+    in.seekg((streamoff)bloque.offset, ios::beg);
+    return readBlock(in, header, prefijo, codificado, rawSize) && loadBlockTable(codificado.data(), codificado.size(), decoder);
+}
 
-    if (offset + sizeof(int) > fileData.size()) return false;
-    //el entero inicial define cuantos bits finales deben ignorarse al reconstruir el flujo
-    paddedBits = (int)readUInt(fileData, offset);
+//grupo fijo de hilos que ejecuta tareas en el orden en que llegan
+//el destructor espera a que terminen las tareas pendientes antes de cerrar los hilos
+class ThreadPool {
+public:
+    explicit ThreadPool(int hilos) : detener(false) {
+        for (int i = 0; i < hilos; ++i) {
+            workers.push_back(thread(&ThreadPool::workerLoop, this));
+        }
+    }
 
-    if (offset + sizeof(unsigned int) > fileData.size()) return false;
-    unsigned int numCodes = readUInt(fileData, offset);
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> lock(m);
+            detener = true;
+        }
+        cv.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+    }
 
-    for (unsigned int i = 0; i < numCodes; ++i) {
-        //recupera cada simbolo y longitud para reconstruir la tabla de codigos
-        if (offset + 1 > fileData.size()) return false;
-        unsigned char symbol = fileData[offset];
-        offset += 1;
+    void submit(const function<void()>& tarea) {
+        {
+            lock_guard<mutex> lock(m);
+            tareas.push_back(tarea);
+        }
+        cv.notify_one();
+    }
+
+private:
+    void workerLoop() {
+        while (true) {
+            function<void()> tarea;
+            {
+                unique_lock<mutex> lock(m);
+                while (!detener && tareas.empty()) cv.wait(lock);
+                if (tareas.empty()) return;
+                tarea = tareas.front();
+                tareas.pop_front();
+            }
+            tarea();
+        }
+    }
 
-        if (offset + sizeof(unsigned int) > fileData.size()) return false;
-        unsigned int len = readUInt(fileData, offset);
+    vector<thread> workers;
+    deque<function<void()> > tareas;
+    mutex m;
+    condition_variable cv;
+    bool detener;
+};
 
-        if (offset + len > fileData.size()) return false;
-        //se reconstruye el codigo literal concatenando exactamente len caracteres
-        string code((const char*)&fileData[offset], len);
-        offset += len;
+//cantidad de hilos a usar, 0 o negativo significa todos los nucleos disponibles
+int resolveThreadCount(int hilos) {
+    if (hilos > 0) return hilos;
+    unsigned int nucleos = thread::hardware_concurrency();
+    return nucleos > 0 ? (int)nucleos : 1;
+}
 
-        codes[symbol] = code;
+//reconstruye el indice recorriendo los prefijos de cada bloque y saltando su parte codificada
+//sirve para archivos v2 sin indice al final, sin decodificar ningun bloque
+bool scanBlockIndex(istream& in, const CpmHeader& header, unsigned long long dataStart, vector<BlockIndexEntry>& indice) {
+    indice.clear();
+    in.clear();
+    in.seekg((streamoff)dataStart, ios::beg);
+
+    unsigned long long posicion = dataStart;
+    vector<unsigned char> prefijo;
+    while (readExact(in, prefijo, 8)) {
+        size_t offset = 0;
+        unsigned int rawSize = readUInt(prefijo, offset);
+        unsigned int encodedSize = readUInt(prefijo, offset);
+        if (rawSize == 0) return true;
+        if (rawSize > header.blockSize || !validEncodedSize(rawSize, encodedSize)) return false;
+
+        BlockIndexEntry entrada;
+        entrada.offset = posicion;
+        entrada.compressedSize = encodedSize + 8;
+        entrada.rawSize = rawSize;
+        indice.push_back(entrada);
+
+        posicion += entrada.compressedSize;
+        in.seekg((streamoff)posicion, ios::beg);
     }
+    return false;
+}
 
-    if (offset + sizeof(unsigned long long) > fileData.size()) return false;
-    //se obtiene el valor original de size para saber hasta donde leer los bytes reconstruidos
-    originalSize = readULL(fileData, offset);
+//arma la ruta de salida de la descompresion usando la carpeta del .cpm y el nombre guardado
+//los .cpm creados desde la entrada estandar no guardan nombre, en ese caso se usa el del .cpm
+string decompressedPath(const string& cpmPath, const string& originalName) {
+    string dir = getDirectory(cpmPath);
+    string nombre = originalName.empty() ? getBaseName(getFileName(cpmPath)) : originalName;
+    string baseO = getBaseName(nombre);
+    string extO = getExtension(nombre);
+    return dir + baseO + "-descomprimido" + extO;
+}
 
-    if (offset + sizeof(unsigned int) > fileData.size()) return false;
-    unsigned int nameLen = readUInt(fileData, offset);
+//bloque en transito dentro del pipeline de compresion
+struct CompressSlot {
+    //copia del bloque, solo se usa cuando la entrada no esta proyectada en memoria
+    vector<unsigned char> original;
+    //inicio del bloque, dentro de la proyeccion o de original
+    const unsigned char* datos;
+    size_t size;
+    vector<unsigned char> codificado;
+    //tablas lz77 del hilo que codifica el bloque, se reutilizan cuando la ranura vuelve a usarse
+    BlockEncoder trabajo;
+    //en el modo de una pasada, tabla elegida por el hilo principal al leer el bloque
+    BlockPlan plan;
+    //etapas medidas en los bloques de esta ranura, se suman al final con --stats
+    CodecStats stats;
+    //los dos campos siguientes se protegen con el mutex del pipeline
+    bool listo;
+    bool ok;
+};
 
-    if (offset + nameLen > fileData.size()) return false;
-    originalName.assign((const char*)&fileData[offset], nameLen);
-    offset += nameLen;
+//comprime los bloques de in, o de entrada si no es NULL, y los escribe en out sin header ni cierre
+//pipeline: el hilo principal lee bloques de CPM_BLOCK_SIZE bytes y los reparte entre los hilos,
+//cada hilo calcula frecuencias, arbol y codigos de su bloque, y el hilo principal escribe
+//los bloques terminados respetando el orden de entrada
+//en el modo de una pasada el hilo principal elige la tabla de cada bloque con una muestra, en orden,
+//porque cada bloque puede reutilizar la del anterior; los hilos solo empaquetan los codigos
+//posicion es donde queda el primer bloque dentro de out; indice y originalSize reciben lo escrito
+//out solo se escribe hacia adelante, por lo que puede ser la salida estandar
+bool compressBlocks(istream& in,
+    const MappedFile* entrada,
+    ostream& out,
+    unsigned long long posicion,
+    const CompressOptions& opciones,
+    vector<BlockIndexEntry>& indice,
+    unsigned long long& originalSize) {
+    //anillo de bloques en transito, dos por hilo para que ningun hilo espere a la lectura
+    //la memoria queda acotada por la cantidad de ranuras y no por el tamano del archivo
+    int hilos = resolveThreadCount(opciones.hilos);
+    vector<CompressSlot> slots((size_t)hilos * 2);
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i].trabajo.stats = statsActivas ? &slots[i].stats : NULL;
+        slots[i].trabajo.tablaExterna = opciones.diccionario ? &opciones.diccionario->codigos : NULL;
+    }
+    mutex slotMutex;
+    condition_variable slotCv;
+    //se declara despues de las ranuras para que sus hilos terminen antes de liberarlas
+    ThreadPool pool(hilos);
+
+    size_t leidos = 0;
+    size_t escritos = 0;
+    size_t posicionEntrada = 0;
+    originalSize = 0;
+    indice.clear();
+    bool fin = false;
+    bool error = false;
+    AdaptiveTable vigente;
+
+    while (!error && (!fin || escritos < leidos)) {
+        //lee un bloque nuevo mientras haya ranuras libres
+        if (!fin && leidos - escritos < slots.size()) {
+            CompressSlot& slot = slots[leidos % slots.size()];
+            if (entrada) {
+                slot.datos = entrada->data() + posicionEntrada;
+                slot.size = min((size_t)CPM_BLOCK_SIZE, entrada->size() - posicionEntrada);
+                posicionEntrada += slot.size;
+            }
+            else {
+                ScopedTimer timer(statsActivas, ETAPA_LECTURA);
+                slot.original.resize(CPM_BLOCK_SIZE);
+                in.read((char*)&slot.original[0], (streamsize)slot.original.size());
+                slot.size = (size_t)in.gcount();
+                slot.datos = &slot.original[0];
+            }
+            if (slot.size == 0) {
+                fin = true;
+                continue;
+            }
+            if (slot.size < CPM_BLOCK_SIZE) fin = true;
+            if (opciones.umbralTabla > 0) {
+                planBlock(slot.datos, slot.size, opciones, vigente, slot.plan, slot.trabajo.stats);
+            }
 
-    return true;
-}
+            {
+                lock_guard<mutex> lock(slotMutex);
+                slot.listo = false;
+            }
+            CompressSlot* tarea = &slot;
+            pool.submit([tarea, &opciones, &slotMutex, &slotCv]() {
+                tarea->codificado.clear();
+                bool ok = opciones.umbralTabla > 0
+                    ? encodePlannedBlock(tarea->datos, tarea->size, tarea->plan, tarea->codificado, opciones, tarea->trabajo)
+                    : encodeBlock(tarea->datos, tarea->size, tarea->codificado, opciones, tarea->trabajo);
+                lock_guard<mutex> lock(slotMutex);
+                tarea->ok = ok;
+                tarea->listo = true;
+                slotCv.notify_all();
+            });
+            leidos++;
+            //si el bloque mas antiguo todavia no termina se sigue leyendo en lugar de esperarlo
+            if (!fin && leidos - escritos < slots.size()) {
+                lock_guard<mutex> lock(slotMutex);
+                if (!slots[escritos % slots.size()].listo) continue;
+            }
+        }
 
-//comprime el archivo original
-//flujo: calcula frecuencias, genera arbol, obtiene codigos, empaqueta bits y escribe header mas payload
-bool compressFile(const string& inputPath) {
-    //lee todo el archivo original para medir frecuencias byte a byte
-    vector<unsigned char> input;
-    if (!readFile(inputPath, input)) {
-        return false;
+        //escribe el bloque mas antiguo, esperando a su hilo si hace falta
+        if (escritos < leidos) {
+            CompressSlot& slot = slots[escritos % slots.size()];
+            {
+                unique_lock<mutex> lock(slotMutex);
+                while (!slot.listo) slotCv.wait(lock);
+            }
+            if (!slot.ok) {
+                cerr << "No se pudo construir el arbol de Huffman.\n";
+                error = true;
+                break;
+            }
+            BlockIndexEntry bloque;
+            bloque.offset = posicion;
+            bloque.compressedSize = (unsigned int)slot.codificado.size();
+            bloque.rawSize = (unsigned int)slot.size;
+            indice.push_back(bloque);
+
+            //cada bloque sale apenas esta listo, sin esperar el final de la entrada
+            {
+                ScopedTimer timer(statsActivas, ETAPA_ESCRITURA);
+                out.write((const char*)&slot.codificado[0], (streamsize)slot.codificado.size());
+            }
+            if (!out) {
+                cerr << "Error escribiendo los datos comprimidos.\n";
+                error = true;
+                break;
+            }
+            posicion += slot.codificado.size();
+            originalSize += slot.size;
+            escritos++;
+        }
     }
 
-    unsigned long long freqs[256];
-    //se inicializa la tabla con ceros antes de sumar apariciones
-    for (int i = 0; i < 256; ++i) freqs[i] = 0;
-    for (size_t i = 0; i < input.size(); ++i) {
-        //cuenta apariciones de cada byte para armar la tabla de frecuencias
-        unsigned char b = input[i];
-        freqs[b]++;
+    if (error) return false;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        mergeStats(slots[i].stats);
     }
 
-    HuffmanNodo* root = buildHuffmanTree(freqs);
-    if (!root) {
-        cerr << "No se pudo construir el arbol de Huffman.\n";
+    if (in.bad()) {
+        cerr << "Error leyendo los datos de entrada.\n";
         return false;
     }
+    return true;
+}
 
-    //inicializa la tabla de codigos antes de recorrer el arbol
-    vector<string> codes(256);
-    //cada posicion del vector representa el codigo binario asociado a su indice como byte
-    buildCodes(root, "", codes);
+//comprime en formato v2 desde in, o desde entrada si no es NULL, hacia out: header, bloques, cierre e indice
+//con diccionario y un solo bloque se omiten el nombre y el indice, como en la salida en memoria de la biblioteca:
+//en un mensaje chico pesarian mas que los datos, y un solo bloque no se reparte entre hilos
+bool compressStream(istream& in, const MappedFile* entrada, ostream& out, const string& fileName, const CompressOptions& opciones) {
+    bool conDiccionario = opciones.diccionario != NULL;
+    //el header se escribe antes que los bloques, el nombre se decide con el tamano de la entrada
+    //(desde la entrada estandar no se conoce, pero tampoco hay nombre que guardar)
+    bool sinNombre = conDiccionario && (entrada ? entrada->size() : remainingBytes(in)) <= CPM_BLOCK_SIZE;
+    vector<unsigned char> header;
+    appendFileHeader(header, sinNombre ? string() : fileName, CPM_BLOCK_SIZE, fileFlags(opciones),
+        conDiccionario ? opciones.diccionario->id : 0);
+    out.write((const char*)&header[0], (streamsize)header.size());
+
+    //posicion de cada bloque escrito, se guarda al final como indice para la descompresion en paralelo
+    vector<BlockIndexEntry> indice;
+    unsigned long long originalSize = 0;
+    if (!compressBlocks(in, entrada, out, header.size(), opciones, indice, originalSize)) return false;
+    unsigned long long posicion = header.size();
+    for (size_t i = 0; i < indice.size(); ++i) {
+        posicion += indice[i].compressedSize;
+    }
 
-    string bitString;
-    //se reserva mas espacio para reducir realocaciones mientras se agregan cadenas de bits
-    bitString.reserve(input.size() * 2);
-    for (size_t i = 0; i < input.size(); ++i) {
-        //concatena la representacion en bits para cada byte original
-        bitString += codes[input[i]];
+    //bloque final vacio que marca el cierre junto con el total original
+    vector<unsigned char> cierre;
+    appendUInt(cierre, 0);
+    appendUInt(cierre, 0);
+    appendULL(cierre, originalSize);
+    if (!conDiccionario || indice.size() > 1) appendBlockIndex(cierre, indice, posicion + 16);
+    ScopedTimer timer(statsActivas, ETAPA_ESCRITURA);
+    out.write((const char*)&cierre[0], (streamsize)cierre.size());
+
+    out.flush();
+    if (!out) {
+        cerr << "Error escribiendo los datos comprimidos.\n";
+        return false;
     }
+    return true;
 
-    int paddedBits = 0;
-    //convierte la cadena de bits a bytes compactos y devuelve cuantos bits finales fueron de relleno
-    vector<unsigned char> compressedData = bitsToBytes(bitString, paddedBits);
+}
+
+//comprime un archivo, por defecto en ArchivoX.cpm junto al original
+bool compressFile(const string& inputPath, const CompressOptions& opciones, const string& outputPath) {
+    //si se puede, los hilos codifican directo desde el archivo proyectado en memoria,
+    //si no se abre en modo binario y cada bloque se copia a su ranura
+    MappedFile entrada;
+    bool proyectado = entrada.open(inputPath, true);
+    ifstream in;
+    if (!proyectado) in.open(inputPath.c_str(), ios::binary);
+    if (!proyectado && !in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << inputPath << "\n";
+        return false;
+    }
 
     //se preparan componentes del nombre para dejar el .cpm en la misma carpeta que la fuente
     string dir = getDirectory(inputPath);
     string fileName = getFileName(inputPath);
     string base = getBaseName(fileName);
-    string compressedPath = dir + base + ".cpm";
+    string compressedPath = outputPath.empty() ? dir + base + ".cpm" : outputPath;
 
     ofstream out(compressedPath.c_str(), ios::binary | ios::trunc);
     if (!out) {
@@ -397,12 +885,8 @@ bool compressFile(const string& inputPath) {
         return false;
     }
 
-    unsigned long long originalSize = (unsigned long long)input.size();
-    string originalName = fileName;
-
-    writeHeader(out, codes, paddedBits, originalSize, originalName);
-    if (!compressedData.empty()) {
-        out.write((const char*)&compressedData[0], (streamsize)compressedData.size());
+    if (!compressStream(in, proyectado ? &entrada : NULL, out, fileName, opciones)) {
+        return false;
     }
 
     cout << "Archivo comprimido correctamente.\n";
@@ -411,9 +895,9 @@ bool compressFile(const string& inputPath) {
     return true;
 }
 
-//descomprime el archivo creado
-//flujo: lee header, reconstruye tabla, expande bits y remueve relleno para obtener los bytes originales
-bool decompressFile(const string& cpmPath) {
+//descomprime un archivo en el formato original (v1), que guarda un unico flujo para todo el archivo
+//flujo: lee header, reconstruye tabla de decodificacion y traduce el flujo de bits descartando el relleno
+bool decompressLegacyFile(const string& cpmPath, const string& outputPath) {
     //carga el archivo comprimido completo para analizar su header y datos binarios
     vector<unsigned char> fileData;
     if (!readFile(cpmPath, fileData)) {
@@ -432,61 +916,31 @@ bool decompressFile(const string& cpmPath) {
         return false;
     }
 
-    //extrae la seccion comprimida restante despues del header
-    vector<unsigned char> compressedBytes;
-    if (offset < fileData.size()) {
-        //copia solo la porcion restante que contiene la data comprimida real
-        compressedBytes.assign(fileData.begin() + offset, fileData.end());
-    }
-    //se expande el arreglo comprimido a una cadena de bits para iterar facilmente sobre cada simbolo
-    string bitString = bytesToBits(compressedBytes);
-
-    if (paddedBits > 0 && paddedBits <= (int)bitString.size()) {
-        //elimina los bits de relleno agregados durante la compresion
-        bitString.resize(bitString.size() - paddedBits);
+    //el payload se decodifica directo desde el buffer leido, sin copiarlo ni expandirlo a texto
+    const unsigned char* payload = offset < fileData.size() ? &fileData[offset] : NULL;
+    size_t payloadSize = fileData.size() - offset;
+    unsigned long long totalBits = (unsigned long long)payloadSize * 8;
+    if (paddedBits > 0 && (unsigned long long)paddedBits <= totalBits) {
+        //los bits de relleno agregados durante la compresion no forman parte del flujo
+        totalBits -= (unsigned long long)paddedBits;
     }
 
-    //diccionario inverso que traduce secuencias de bits a su byte asociado
-    map<string, unsigned char> reverseCodes;
-    for (int i = 0; i < 256; ++i) {
-        if (!codes[i].empty()) {
-            //se crea un mapa inverso para traducir secuencias de bits a bytes originales
-            reverseCodes[codes[i]] = (unsigned char)i;
-        }
-    }
-
-    vector<unsigned char> output;
-    if (originalSize > 0) {
-        //reserva un size aproximado para evitar realocaciones
-        output.reserve((size_t)originalSize);
-    }
-
-    //buffer temporal con los bits acumulados hasta formar un codigo valido
-    string current;
-    for (size_t i = 0; i < bitString.size(); ++i) {
-        current.push_back(bitString[i]);
-        map<string, unsigned char>::iterator it = reverseCodes.find(current);
-        if (it != reverseCodes.end()) {
-            //cuando se encuentra un codigo completo se agrega el byte correspondiente
-            output.push_back(it->second);
-            current.clear();
-            if (originalSize > 0 && output.size() >= (size_t)originalSize) {
-                break;
-            }
-        }
+    CodeTable tabla;
+    HuffmanDecoder decoder;
+    if (!buildCodeTable(codes, tabla) || !buildDecoder(tabla, decoder)) {
+        cerr << "Tabla de codigos invalida.\n";
+        return false;
     }
 
-    if (originalSize > 0 && output.size() > (size_t)originalSize) {
-        //si la reconstruccion genero bytes extra por padding, se recorta usando el size almacenado
-        output.resize((size_t)originalSize);
+    vector<unsigned char> output((size_t)originalSize);
+    size_t producidos = 0;
+    if (payload && !output.empty()) {
+        producidos = decodeSymbols(decoder, payload, payloadSize, totalBits, &output[0], output.size());
     }
+    //si los datos se agotan antes del size esperado se conserva solo lo recuperado
+    output.resize(producidos);
 
-    //se recrea el nombre de salida usando la carpeta original mas un sufijo descriptivo
-    string dir = getDirectory(cpmPath);
-    string baseO = getBaseName(originalName);
-    string extO = getExtension(originalName);
-    string outputName = dir + baseO + "-descomprimido" + extO;
-
+    string outputName = outputPath.empty() ? decompressedPath(cpmPath, originalName) : outputPath;
     if (!writeFile(outputName, output)) {
         return false;
     }
@@ -498,59 +952,1711 @@ bool decompressFile(const string& cpmPath) {
     return true;
 }
 
-//punto de entrada con menu interactivo basico para elegir operacion
-int main() {
-    cout << "============================================\n";
-    cout << "  COMPRESOR / DESCOMPRESOR HUFFMAN (.cpm)\n";
-    cout << "============================================\n\n";
+//descomprime bloque a bloque en orden, para archivos sin indice o datos que llegan por un flujo
+//cada bloque se escribe apenas se decodifica, y lo que sigue al bloque de cierre (el indice) no se lee
+bool decompressBlocksSequential(istream& in, const CpmHeader& header, ostream& out) {
+    //se reutilizan los mismos buffers para todos los bloques
+    vector<unsigned char> prefijo;
+    vector<unsigned char> codificado;
+    vector<unsigned char> salida;
+    BlockDecoder decoder;
+    decoder.stats = statsActivas;
+    decoder.tablaExterna = dictionaryTable(header);
+    bool checksum = (header.flags & CPM_FLAG_CRC32C) != 0;
+    unsigned long long totalEscrito = 0;
+    bool cerrado = false;
+
+    while (true) {
+        {
+            ScopedTimer timer(statsActivas, ETAPA_LECTURA);
+            if (!readExact(in, prefijo, 8)) break;
+        }
+        size_t offset = 0;
+        unsigned int rawSize = readUInt(prefijo, offset);
+        unsigned int encodedSize = readUInt(prefijo, offset);
+
+        if (rawSize == 0) {
+            //bloque de cierre: solo un total que coincide con lo reconstruido indica que no faltan datos
+            vector<unsigned char> total;
+            offset = 0;
+            cerrado = readExact(in, total, 8) && readULL(total, offset) == totalEscrito;
+            break;
+        }
 
-    int opcion;
-    string entrada;
+        if (rawSize > header.blockSize || !validEncodedSize(rawSize, encodedSize)) break;
+        {
+            ScopedTimer timer(statsActivas, ETAPA_LECTURA);
+            if (encodedSize > remainingBytes(in) || !readExact(in, codificado, encodedSize)) break;
+        }
 
-    do {
-        //muestra las opciones disponibles y lee la accion del usuario
-        cout << "\nMENU:\n";
-        cout << "1. Comprimir archivo (ArchivoX.ext -> ArchivoX.cpm)\n";
-        cout << "2. Descomprimir archivo (ArchivoX.cpm -> ArchivoX-descomprimido.ext)\n";
-        cout << "0. Salir\n";
-        cout << "Seleccione una opcion: ";
+        salida.resize(rawSize);
+        if (!decodeBlock(codificado.data(), codificado.size(), rawSize, &salida[0], decoder, checksum)) break;
 
-        if (!(cin >> opcion)) {
-            cin.clear();
-            cin.ignore(10000, '\n');
-            cout << "Entrada invalida. Intente de nuevo.\n";
-            continue;
+        {
+            ScopedTimer timer(statsActivas, ETAPA_ESCRITURA);
+            out.write((const char*)&salida[0], (streamsize)rawSize);
         }
+        if (!out) break;
+        totalEscrito += rawSize;
+    }
 
-        switch (opcion) {
-        case 1:
-            cout << "\n--- COMPRESION ---\n";
-            cout << "Ingrese ruta del archivo a comprimir (ArchivoX.ext): ";
-            cin >> entrada;
-            if (!compressFile(entrada)) {
-                cout << "Ocurrio un error al comprimir.\n";
-            }
-            break;
+    out.flush();
+    if (!out) {
+        cerr << "Error escribiendo los datos descomprimidos.\n";
+        return false;
+    }
+    if (!cerrado) {
+        cerr << "Datos comprimidos incompletos o danados.\n";
+        return false;
+    }
+    return true;
+}
 
-        case 2:
-            cout << "\n--- DESCOMPRESION ---\n";
-            cout << "Ingrese ruta del archivo comprimido (.cpm): ";
-            cin >> entrada;
-            if (!decompressFile(entrada)) {
-                cout << "Ocurrio un error al descomprimir.\n";
-            }
-            break;
+//descomprime usando el indice: cada hilo toma el siguiente bloque libre, lo decodifica
+//y lo escribe directamente en su posicion final dentro del archivo de salida
+//con danados distinto de NULL solo se verifica: no se crea la salida, cada bloque se decodifica en un
+//buffer del hilo y los que fallan se anotan en danados (ordenados) en lugar de cortar el proceso
+bool decompressBlocksParallel(const string& cpmPath,
+    const CpmHeader& header,
+    const vector<BlockIndexEntry>& indice,
+    const string& outputName,
+    int threads,
+    vector<size_t>* danados) {
+    //la posicion de cada bloque en la salida es la suma de los tamanos originales anteriores
+    vector<unsigned long long> destino(indice.size());
+    unsigned long long total = 0;
+    for (size_t i = 0; i < indice.size(); ++i) {
+        destino[i] = total;
+        total += indice[i].rawSize;
+    }
 
-        case 0:
-            cout << "Saliendo del programa...\n";
-            break;
+    //el .cpm se lee proyectado en memoria y cada bloque se decodifica sin copiarlo
+    MappedFile entrada;
+    bool entradaProyectada = entrada.open(cpmPath, true);
+
+    //la salida se crea con su tamano final para que cada hilo escriba en su propio tramo;
+    //proyectada en memoria, cada bloque se decodifica directo en su posicion del archivo
+    bool verificar = danados != NULL;
+    MappedOutput salidaProyectada;
+    bool proyectada = !verificar && salidaProyectada.create(outputName, total);
+    if (!proyectada && !verificar) {
+        ofstream out(outputName.c_str(), ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "No se pudo abrir el archivo de salida: " << outputName << "\n";
+            return false;
+        }
+        if (total > 0) {
+            out.seekp((streamoff)(total - 1));
+            out.put(0);
+        }
+        if (!out) {
+            cerr << "Error escribiendo el archivo de salida: " << outputName << "\n";
+            return false;
+        }
+    }
 
-        default:
-            cout << "Opcion no valida. Intente nuevamente.\n";
-            break;
+    atomic<size_t> siguiente(0);
+    atomic<bool> error(false);
+    bool checksum = (header.flags & CPM_FLAG_CRC32C) != 0;
+    mutex danadosMutex;
+
+    //cada hilo decodifica bloques salteados, asi que un bloque de modo 5 no puede contar con que su hilo
+    //haya pasado por el bloque que define la tabla: se ubica de antemano y el hilo la carga cuando cambia
+    bool tablaVigente = (header.flags & CPM_FLAG_TABLA_VIGENTE) != 0;
+    vector<size_t> fuente;
+    if (tablaVigente) {
+        ifstream modos;
+        if (!entradaProyectada) modos.open(cpmPath.c_str(), ios::binary);
+        findTableSources(modos, entradaProyectada ? &entrada : NULL, indice, fuente);
+    }
+
+    //sin proyeccion cada hilo abre sus propios flujos para poder posicionarse sin coordinarse con los demas
+    function<void()> worker = [&]() {
+        ifstream in;
+        fstream out;
+        if (!entradaProyectada) in.open(cpmPath.c_str(), ios::binary);
+        if (!proyectada && !verificar) out.open(outputName.c_str(), ios::in | ios::out | ios::binary);
+        if ((!entradaProyectada && !in) || (!proyectada && !verificar && !out)) {
+            error = true;
+            return;
         }
 
-    } while (opcion != 0);
+        vector<unsigned char> prefijo;
+        vector<unsigned char> codificado;
+        vector<unsigned char> salida;
+        BlockDecoder decoder;
+        CodecStats parcial;
+        CodecStats* stats = statsActivas ? &parcial : NULL;
+        decoder.stats = stats;
+        decoder.tablaExterna = dictionaryTable(header);
+        //bloque del que sale la tabla vigente que tiene armada este hilo
+        size_t cargada = SIN_FUENTE;
+        vector<unsigned char> prefijoTabla;
+        vector<unsigned char> codificadoTabla;
+        while (!error) {
+            size_t i = siguiente++;
+            if (i >= indice.size()) break;
+
+            //parte codificada del bloque, dentro de la proyeccion o leida en codificado
+            const unsigned char* bloque = NULL;
+            size_t encodedSize = 0;
+            unsigned int rawSize = 0;
+            bool valido;
+            if (entradaProyectada) {
+                valido = indice[i].offset <= entrada.size() && indice[i].compressedSize <= entrada.size() - indice[i].offset;
+                if (valido) {
+                    size_t offset = 0;
+                    bloque = entrada.data() + indice[i].offset;
+                    rawSize = readUInt(bloque, 8, offset);
+                    encodedSize = readUInt(bloque, 8, offset);
+                    bloque += 8;
+                }
+            }
+            else {
+                ScopedTimer timer(stats, ETAPA_LECTURA);
+                in.clear();
+                in.seekg((streamoff)indice[i].offset, ios::beg);
+                valido = readBlock(in, header, prefijo, codificado, rawSize);
+                bloque = codificado.data();
+                encodedSize = codificado.size();
+            }
+            valido = valido && rawSize == indice[i].rawSize && encodedSize + 8 == indice[i].compressedSize;
 
-    return 0;
+            if (valido && tablaVigente && encodedSize > 0 && bloque[0] == BLOQUE_TABLA_EXTERNA && fuente[i] != cargada) {
+                cargada = fuente[i];
+                valido = cargada != SIN_FUENTE &&
+                    loadTableSource(in, entradaProyectada ? &entrada : NULL, header, indice[cargada], prefijoTabla, codificadoTabla, decoder);
+                if (!valido) cargada = SIN_FUENTE;
+            }
+            if (valido) {
+                unsigned char* destinoBloque;
+                if (proyectada) {
+                    destinoBloque = salidaProyectada.data() + destino[i];
+                }
+                else {
+                    salida.resize(rawSize);
+                    destinoBloque = &salida[0];
+                }
+                valido = decodeBlock(bloque, encodedSize, rawSize, destinoBloque, decoder, checksum);
+                if (tablaVigente && encodedSize > 0 && bloque[0] == BLOQUE_TABLA_NUEVA) cargada = decoder.tablaExterna ? i : SIN_FUENTE;
+            }
+            if (!valido && verificar) {
+                lock_guard<mutex> lock(danadosMutex);
+                danados->push_back(i);
+                continue;
+            }
+            if (!valido) {
+                error = true;
+                break;
+            }
+
+            if (!proyectada && !verificar) {
+                ScopedTimer timer(stats, ETAPA_ESCRITURA);
+                out.seekp((streamoff)destino[i], ios::beg);
+                out.write((const char*)&salida[0], (streamsize)rawSize);
+                if (!out) error = true;
+            }
+        }
+        mergeStats(parcial);
+    };
+
+    //con un solo hilo se trabaja directamente en el hilo principal
+    int hilos = resolveThreadCount(threads);
+    if ((size_t)hilos > indice.size()) hilos = indice.empty() ? 1 : (int)indice.size();
+    vector<thread> workers;
+    for (int i = 1; i < hilos; ++i) {
+        workers.push_back(thread(worker));
+    }
+    worker();
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].join();
+    }
+
+    if (error) {
+        cerr << "Datos comprimidos incompletos o danados.\n";
+        return false;
+    }
+    if (verificar) sort(danados->begin(), danados->end());
+    return true;
+}
+
+//descomprime el archivo creado
+//los archivos v2 con indice se reparten entre varios hilos, sin indice se recorren bloque a bloque,
+//y los que no tienen magic se tratan como v1; un .cpa se desempaqueta en una carpeta
+//outputPath vacio usa ArchivoX-descomprimido.ext junto al .cpm
+bool decompressFile(const string& cpmPath, int threads, const string& outputPath) {
+    ifstream in(cpmPath.c_str(), ios::binary);
+    if (!in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << cpmPath << "\n";
+        return false;
+    }
+
+    vector<unsigned char> magic;
+    bool leido = readExact(in, magic, 4);
+    if (leido && memcmp(&magic[0], CPA_MAGIC, 4) == 0) {
+        //un .cpa se desempaqueta completo; outputPath es la carpeta destino
+        in.close();
+        return extractArchive(cpmPath, "", outputPath, threads, false);
+    }
+    if (!leido || memcmp(&magic[0], CPM_MAGIC, 4) != 0) {
+        in.close();
+        return decompressLegacyFile(cpmPath, outputPath);
+    }
+
+    CpmHeader header;
+    if (!readFileHeader(in, header)) {
+        cerr << "Header de Huffman invalido.\n";
+        return false;
+    }
+    if (!checkDictionary(header)) return false;
+    unsigned long long dataStart = headerSize(header);
+
+    string outputName = outputPath.empty() ? decompressedPath(cpmPath, header.originalName) : outputPath;
+    vector<BlockIndexEntry> indice;
+    bool ok;
+    if (readBlockIndex(in, header, dataStart, indice)) {
+        ok = decompressBlocksParallel(cpmPath, header, indice, outputName, threads, NULL);
+    }
+    else {
+        in.clear();
+        in.seekg((streamoff)dataStart, ios::beg);
+        ofstream out(outputName.c_str(), ios::binary | ios::trunc);
+        if (!out) {
+            cerr << "No se pudo abrir el archivo de salida: " << outputName << "\n";
+            return false;
+        }
+        ok = decompressBlocksSequential(in, header, out);
+    }
+    if (!ok) return false;
+
+    cout << "Archivo descomprimido correctamente.\n";
+    cout << "Archivo .cpm             : " << cpmPath << "\n";
+    cout << "Nombre original (header) : " << header.originalName << "\n";
+    cout << "Archivo descomprimido    : " << outputName << "\n";
+    return true;
+}
+
+//descomprime un .cpm v2 que llega por un flujo, como la entrada estandar
+//los bloques se leen en orden y cada uno se escribe en out apenas se decodifica
+bool decompressStream(istream& in, ostream& out) {
+    vector<unsigned char> magic;
+    if (!readExact(in, magic, 4) || memcmp(&magic[0], CPM_MAGIC, 4) != 0) {
+        cerr << "Los datos no son un archivo .cpm por bloques (v2).\n";
+        return false;
+    }
+
+    CpmHeader header;
+    if (!readFileHeader(in, header)) {
+        cerr << "Header de Huffman invalido.\n";
+        return false;
+    }
+    if (!checkDictionary(header)) return false;
+    return decompressBlocksSequential(in, header, out);
+}
+
+//recupera solo los bytes originales [offset, offset + length) de un .cpm v2
+//usa el indice para ubicar y decodificar unicamente los bloques que cubren el rango,
+//si el rango pasa del final del archivo se devuelve hasta el final
+bool extractRange(const string& cpmPath,
+    unsigned long long offset,
+    unsigned long long length,
+    vector<unsigned char>& out,
+    string& originalName) {
+    out.clear();
+    ifstream in(cpmPath.c_str(), ios::binary);
+    if (!in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << cpmPath << "\n";
+        return false;
+    }
+
+    vector<unsigned char> magic;
+    if (!readExact(in, magic, 4) || memcmp(&magic[0], CPM_MAGIC, 4) != 0) {
+        cerr << "La extraccion por rango solo esta disponible para archivos .cpm por bloques (v2).\n";
+        return false;
+    }
+
+    CpmHeader header;
+    if (!readFileHeader(in, header)) {
+        cerr << "Header de Huffman invalido.\n";
+        return false;
+    }
+    if (!checkDictionary(header)) return false;
+    originalName = header.originalName;
+    unsigned long long dataStart = headerSize(header);
+
+    vector<BlockIndexEntry> indice;
+    if (!readBlockIndex(in, header, dataStart, indice) && !scanBlockIndex(in, header, dataStart, indice)) {
+        cerr << "Datos comprimidos incompletos o danados.\n";
+        return false;
+    }
+
+    //inicio de cada bloque dentro del archivo original
+    vector<unsigned long long> inicios(indice.size());
+    unsigned long long total = 0;
+    for (size_t i = 0; i < indice.size(); ++i) {
+        inicios[i] = total;
+        total += indice[i].rawSize;
+    }
+
+    if (offset > total) {
+        cerr << "La posicion pedida esta fuera del archivo original (" << total << " bytes).\n";
+        return false;
+    }
+    unsigned long long fin = length > total - offset ? total : offset + length;
+    if (fin == offset) return true;
+    out.reserve((size_t)(fin - offset));
+
+    //primer bloque cuyo rango contiene offset
+    size_t i = (size_t)(upper_bound(inicios.begin(), inicios.end(), offset) - inicios.begin()) - 1;
+
+    vector<unsigned char> prefijo;
+    vector<unsigned char> codificado;
+    vector<unsigned char> salida;
+    BlockDecoder decoder;
+    decoder.stats = statsActivas;
+    decoder.tablaExterna = dictionaryTable(header);
+    bool checksum = (header.flags & CPM_FLAG_CRC32C) != 0;
+
+    //con tabla vigente el rango puede empezar en un bloque que reutiliza la tabla de uno anterior:
+    //se busca hacia atras el ultimo bloque de modo 6 y se carga solo su tabla
+    if ((header.flags & CPM_FLAG_TABLA_VIGENTE) != 0) {
+        size_t j = i;
+        while (j > 0 && readBlockMode(in, NULL, indice[j]) != BLOQUE_TABLA_NUEVA) j--;
+        if (j < i && readBlockMode(in, NULL, indice[j]) == BLOQUE_TABLA_NUEVA &&
+            !loadTableSource(in, NULL, header, indice[j], prefijo, codificado, decoder)) {
+            cerr << "Datos comprimidos incompletos o danados.\n";
+            return false;
+        }
+    }
+    for (; i < indice.size() && inicios[i] < fin; ++i) {
+        unsigned int rawSize = 0;
+        in.clear();
+        in.seekg((streamoff)indice[i].offset, ios::beg);
+        if (!readBlock(in, header, prefijo, codificado, rawSize) || rawSize != indice[i].rawSize) {
+            cerr << "Datos comprimidos incompletos o danados.\n";
+            return false;
+        }
+
+        salida.resize(rawSize);
+        if (!decodeBlock(codificado.data(), codificado.size(), rawSize, &salida[0], decoder, checksum)) {
+            cerr << "Datos comprimidos incompletos o danados.\n";
+            return false;
+        }
+
+        //se copia solo la parte del bloque que cae dentro del rango
+        size_t desde = offset > inicios[i] ? (size_t)(offset - inicios[i]) : 0;
+        size_t hasta = fin < inicios[i] + rawSize ? (size_t)(fin - inicios[i]) : rawSize;
+        out.insert(out.end(), salida.begin() + desde, salida.begin() + hasta);
+    }
+    return true;
+}
+
+//extrae un rango de bytes originales a un archivo, por defecto ArchivoX-extraido.ext junto al .cpm
+bool extractFile(const string& cpmPath, unsigned long long offset, unsigned long long length, const string& outputPath) {
+    vector<unsigned char> datos;
+    string originalName;
+    if (!extractRange(cpmPath, offset, length, datos, originalName)) {
+        return false;
+    }
+
+    string outputName = outputPath;
+    if (outputName.empty()) {
+        outputName = getDirectory(cpmPath) + getBaseName(originalName) + "-extraido" + getExtension(originalName);
+    }
+    if (!writeFile(outputName, datos)) {
+        return false;
+    }
+
+    cout << "Rango extraido correctamente.\n";
+    cout << "Archivo .cpm     : " << cpmPath << "\n";
+    cout << "Desde el byte    : " << offset << "\n";
+    cout << "Bytes extraidos  : " << datos.size() << "\n";
+    cout << "Archivo de salida: " << outputName << "\n";
+    return true;
+}
+
+//comprueba un .cpm v2 sin escribir ninguna salida: decodifica cada bloque (en paralelo, sobre el archivo
+//proyectado en memoria), compara su crc32c y revisa que el cierre coincida con el total de los bloques
+//informa cada bloque danado con el rango de bytes originales que cubre; en un .cpa comprueba cada miembro
+bool verifyFile(const string& cpmPath, int threads) {
+    ifstream in(cpmPath.c_str(), ios::binary);
+    if (!in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << cpmPath << "\n";
+        return false;
+    }
+
+    vector<unsigned char> magic;
+    bool leido = readExact(in, magic, 4);
+    if (leido && memcmp(&magic[0], CPA_MAGIC, 4) == 0) {
+        in.close();
+        return extractArchive(cpmPath, "", "", threads, true);
+    }
+    if (!leido || memcmp(&magic[0], CPM_MAGIC, 4) != 0) {
+        cerr << "La verificacion solo esta disponible para archivos .cpm por bloques (v2) y .cpa.\n";
+        return false;
+    }
+
+    CpmHeader header;
+    if (!readFileHeader(in, header)) {
+        cerr << "Header de Huffman invalido.\n";
+        return false;
+    }
+    if (!checkDictionary(header)) return false;
+    unsigned long long dataStart = headerSize(header);
+
+    vector<BlockIndexEntry> indice;
+    if (!readBlockIndex(in, header, dataStart, indice) && !scanBlockIndex(in, header, dataStart, indice)) {
+        cerr << "Datos comprimidos incompletos o danados: no se pudo recorrer la lista de bloques.\n";
+        return false;
+    }
+
+    //el cierre sigue al ultimo bloque y guarda el total de bytes originales
+    unsigned long long total = 0;
+    for (size_t i = 0; i < indice.size(); ++i) {
+        total += indice[i].rawSize;
+    }
+    unsigned long long posicionCierre = indice.empty() ? dataStart : indice.back().offset + indice.back().compressedSize;
+    vector<unsigned char> cierre;
+    in.clear();
+    in.seekg((streamoff)posicionCierre, ios::beg);
+    size_t offset = 0;
+    bool cierreValido = readExact(in, cierre, 16) && readUInt(cierre, offset) == 0 && readUInt(cierre, offset) == 0 &&
+        readULL(cierre, offset) == total;
+
+    vector<size_t> danados;
+    if (!decompressBlocksParallel(cpmPath, header, indice, "", threads, &danados)) {
+        return false;
+    }
+
+    bool checksum = (header.flags & CPM_FLAG_CRC32C) != 0;
+    if (!checksum) {
+        cout << "Aviso: el archivo no guarda crc por bloque, solo se comprueba que cada bloque se pueda decodificar.\n";
+    }
+    if (!danados.empty() || !cierreValido) {
+        unsigned long long inicio = 0;
+        size_t k = 0;
+        for (size_t i = 0; i < indice.size() && k < danados.size(); ++i) {
+            if (danados[k] == i) {
+                cerr << "Bloque " << i << " danado (bytes originales " << inicio << " a " << inicio + indice[i].rawSize - 1 << ").\n";
+                k++;
+            }
+            inicio += indice[i].rawSize;
+        }
+        if (!cierreValido) cerr << "El cierre del archivo no coincide con sus bloques (archivo truncado o danado).\n";
+        cerr << "Verificacion fallida: " << danados.size() << " de " << indice.size() << " bloques danados.\n";
+        return false;
+    }
+
+    cout << "Archivo verificado correctamente.\n";
+    cout << "Archivo .cpm     : " << cpmPath << "\n";
+    cout << "Bloques          : " << indice.size() << "\n";
+    cout << "Bytes originales : " << total << "\n";
+    return true;
+}
+
+//convierte un numero decimal de la linea de comandos, rechaza texto sobrante o valores negativos
+bool parseNumber(const char* texto, unsigned long long& valor) {
+    if (!texto || *texto < '0' || *texto > '9') return false;
+    char* fin = NULL;
+    valor = strtoull(texto, &fin, 10);
+    return fin && *fin == '\0';
+}
+
+//prepara la entrada y salida estandar para transportar datos binarios
+void prepareStandardStreams() {
+#if defined(_WIN32)
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    //sin sincronizar con stdio, cin y cout usan su propio buffer y leen o escriben bloques completos
+    ios::sync_with_stdio(false);
+}
+
+//entrada del directorio de un .cpa
+struct ArchiveMember {
+    //ruta relativa a la carpeta empaquetada, con '/' como separador
+    string nombre;
+    unsigned long long tamanoOriginal;
+    //posicion del primer bloque dentro del .cpa y bytes que ocupan todos sus bloques
+    unsigned long long posicion;
+    unsigned long long tamanoComprimido;
+    //tabla compartida que usan sus bloques, CPA_SIN_TABLA si ninguna
+    unsigned int tabla;
+};
+
+//longitudes de una tabla compartida, suficientes para reconstruir sus codigos canonicos
+struct ArchiveTable {
+    unsigned char lengths[256];
+};
+
+//header y directorio de un .cpa
+struct ArchiveDirectory {
+    unsigned char flags;
+    unsigned int blockSize;
+    vector<ArchiveTable> tablas;
+    vector<ArchiveMember> miembros;
+};
+
+//agrega los archivos regulares de carpeta/relativa y sus subcarpetas, con su nombre relativo y su tamano
+//los enlaces simbolicos se omiten para no salir de la carpeta ni recorrer ciclos
+bool listFiles(const string& carpeta, const string& relativa, vector<ArchiveMember>& miembros, vector<string>& rutas) {
+    string base = relativa.empty() ? carpeta : carpeta + "/" + relativa;
+#if defined(_WIN32)
+    WIN32_FIND_DATAA datos;
+    HANDLE busqueda = FindFirstFileA((base + "\\*").c_str(), &datos);
+    if (busqueda == INVALID_HANDLE_VALUE) return false;
+    bool ok = true;
+    do {
+        string nombre = datos.cFileName;
+        if (nombre == "." || nombre == ".." || (datos.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) continue;
+        string rel = relativa.empty() ? nombre : relativa + "/" + nombre;
+        if (datos.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+            ok = listFiles(carpeta, rel, miembros, rutas);
+        }
+        else {
+            ArchiveMember miembro;
+            miembro.nombre = rel;
+            miembro.tamanoOriginal = ((unsigned long long)datos.nFileSizeHigh << 32) | datos.nFileSizeLow;
+            miembros.push_back(miembro);
+            rutas.push_back(base + "/" + nombre);
+        }
+    } while (ok && FindNextFileA(busqueda, &datos));
+    FindClose(busqueda);
+    return ok;
+#else
+    DIR* dir = opendir(base.c_str());
+    if (!dir) return false;
+    bool ok = true;
+    struct dirent* entrada;
+    while (ok && (entrada = readdir(dir)) != NULL) {
+        string nombre = entrada->d_name;
+        if (nombre == "." || nombre == "..") continue;
+        string ruta = base + "/" + nombre;
+        string rel = relativa.empty() ? nombre : relativa + "/" + nombre;
+        struct stat info;
+        if (lstat(ruta.c_str(), &info) != 0) {
+            ok = false;
+        }
+        else if (S_ISDIR(info.st_mode)) {
+            ok = listFiles(carpeta, rel, miembros, rutas);
+        }
+        else if (S_ISREG(info.st_mode)) {
+            ArchiveMember miembro;
+            miembro.nombre = rel;
+            miembro.tamanoOriginal = (unsigned long long)info.st_size;
+            miembros.push_back(miembro);
+            rutas.push_back(ruta);
+        }
+    }
+    closedir(dir);
+    return ok;
+#endif
+}
+
+//crea las carpetas que faltan antes del ultimo separador de ruta; las que ya existen se dejan igual
+void createParentDirectories(const string& ruta) {
+    for (size_t pos = ruta.find_first_of("/\\", 1); pos != string::npos; pos = ruta.find_first_of("/\\", pos + 1)) {
+        string carpeta = ruta.substr(0, pos);
+#if defined(_WIN32)
+        _mkdir(carpeta.c_str());
+#else
+        mkdir(carpeta.c_str(), 0755);
+#endif
+    }
+}
+
+//un nombre del directorio es seguro si es relativo y no sube de carpeta, asi extraer nunca escribe fuera del destino
+bool safeMemberName(const string& nombre) {
+    if (nombre.empty() || nombre[0] == '/' || nombre.find_first_of("\\:") != string::npos) return false;
+    size_t inicio = 0;
+    while (inicio <= nombre.size()) {
+        size_t fin = nombre.find('/', inicio);
+        if (fin == string::npos) fin = nombre.size();
+        string parte = nombre.substr(inicio, fin - inicio);
+        if (parte.empty() || parte == "." || parte == "..") return false;
+        inicio = fin + 1;
+    }
+    return true;
+}
+
+//lote de archivos en transito dentro del pipeline de empaquetado
+struct ArchiveSlot {
+    //primer miembro y uno despues del ultimo
+    size_t desde;
+    size_t hasta;
+    //contenido de todos los archivos del lote, uno detras del otro
+    vector<unsigned char> datos;
+    vector<unsigned char> codificado;
+    //bytes que ocupan en codificado los bloques de cada miembro
+    vector<unsigned long long> tamanos;
+    ArchiveTable tabla;
+    //algun bloque del lote quedo codificado con la tabla compartida
+    bool usaTabla;
+    BlockEncoder trabajo;
+    CodecStats stats;
+    string error;
+    //los dos campos siguientes se protegen con el mutex del pipeline
+    bool listo;
+    bool ok;
+};
+
+//lee y codifica los archivos de un lote, cada uno en su propio bloque
+//con varios archivos se arma una tabla con las frecuencias de todo el lote y cada bloque la usa
+//en lugar de guardar la suya cuando eso lo achica
+bool compressArchiveLote(const vector<ArchiveMember>& miembros, const vector<string>& rutas, const CompressOptions& opciones, ArchiveSlot& slot) {
+    CodecStats* stats = slot.trabajo.stats;
+    slot.codificado.clear();
+    slot.tamanos.clear();
+    slot.usaTabla = false;
+
+    unsigned long long total = 0;
+    for (size_t i = slot.desde; i < slot.hasta; ++i) {
+        total += miembros[i].tamanoOriginal;
+    }
+    slot.datos.resize((size_t)total);
+    {
+        ScopedTimer timer(stats, ETAPA_LECTURA);
+        size_t posicion = 0;
+        for (size_t i = slot.desde; i < slot.hasta; ++i) {
+            size_t tamano = (size_t)miembros[i].tamanoOriginal;
+            if (tamano == 0) continue;
+            ifstream in(rutas[i].c_str(), ios::binary);
+            in.read((char*)&slot.datos[posicion], (streamsize)tamano);
+            if ((size_t)in.gcount() != tamano) {
+                slot.error = "No se pudo leer el archivo (o cambio mientras se empaquetaba): " + rutas[i];
+                return false;
+            }
+            posicion += tamano;
+        }
+    }
+
+    CodeTable compartida;
+    slot.trabajo.tablaExterna = NULL;
+    if (slot.hasta - slot.desde > 1 && total > 0) {
+        unsigned long long freqs[256];
+        {
+            ScopedTimer timer(stats, ETAPA_HISTOGRAMA);
+            countFrequencies(&slot.datos[0], slot.datos.size(), freqs);
+        }
+        ScopedTimer timer(stats, ETAPA_ARBOL);
+        if (buildLimitedLengths(freqs, opciones.maxLongitud, slot.tabla.lengths) && buildCanonicalCodes(slot.tabla.lengths, compartida)) {
+            slot.trabajo.tablaExterna = &compartida;
+        }
+    }
+
+    size_t posicion = 0;
+    for (size_t i = slot.desde; i < slot.hasta; ++i) {
+        size_t tamano = (size_t)miembros[i].tamanoOriginal;
+        size_t antes = slot.codificado.size();
+        if (tamano > 0) {
+            if (!encodeBlock(&slot.datos[posicion], tamano, slot.codificado, opciones, slot.trabajo)) {
+                slot.error = "No se pudo construir el arbol de Huffman.";
+                slot.trabajo.tablaExterna = NULL;
+                return false;
+            }
+            if (slot.codificado[antes + 8] == BLOQUE_TABLA_EXTERNA) slot.usaTabla = true;
+        }
+        slot.tamanos.push_back(slot.codificado.size() - antes);
+        posicion += tamano;
+    }
+    slot.trabajo.tablaExterna = NULL;
+    return true;
+}
+
+//empaqueta todos los archivos de una carpeta (y sus subcarpetas) en un .cpa, por defecto CarpetaX.cpa junto a ella
+//los archivos de varios bloques se comprimen uno tras otro repartiendo sus bloques entre los hilos;
+//los de un solo bloque se reparten en lotes entre los hilos y un hilo escribe los lotes en orden
+bool compressArchive(const string& carpetaPath, const CompressOptions& pedidas, const string& outputPath) {
+    //un .cpa ya comparte tablas entre sus archivos chicos y su directorio no guarda diccionario
+    CompressOptions opciones = pedidas;
+    opciones.diccionario = NULL;
+    string carpeta = carpetaPath;
+    while (carpeta.size() > 1 && (carpeta[carpeta.size() - 1] == '/' || carpeta[carpeta.size() - 1] == '\\')) {
+        carpeta.erase(carpeta.size() - 1);
+    }
+
+    vector<ArchiveMember> encontrados;
+    vector<string> rutasEncontradas;
+    if (!listFiles(carpeta, "", encontrados, rutasEncontradas)) {
+        cerr << "No se pudo recorrer la carpeta: " << carpeta << "\n";
+        return false;
+    }
+
+    //primero los archivos de varios bloques, despues los medianos y al final los chicos ordenados por
+    //extension, asi cada lote reune archivos del mismo tipo y su tabla compartida les sirve a todos
+    vector<size_t> orden(encontrados.size());
+    for (size_t i = 0; i < orden.size(); ++i) orden[i] = i;
+    sort(orden.begin(), orden.end(), [&](size_t a, size_t b) {
+        const ArchiveMember& x = encontrados[a];
+        const ArchiveMember& y = encontrados[b];
+        int claseX = x.tamanoOriginal > CPM_BLOCK_SIZE ? 0 : (x.tamanoOriginal > CPA_ARCHIVO_CHICO ? 1 : 2);
+        int claseY = y.tamanoOriginal > CPM_BLOCK_SIZE ? 0 : (y.tamanoOriginal > CPA_ARCHIVO_CHICO ? 1 : 2);
+        if (claseX != claseY) return claseX < claseY;
+        string extX = getExtension(getFileName(x.nombre));
+        string extY = getExtension(getFileName(y.nombre));
+        if (extX != extY) return extX < extY;
+        return x.nombre < y.nombre;
+    });
+    vector<ArchiveMember> miembros(orden.size());
+    vector<string> rutas(orden.size());
+    for (size_t i = 0; i < orden.size(); ++i) {
+        miembros[i] = encontrados[orden[i]];
+        rutas[i] = rutasEncontradas[orden[i]];
+        miembros[i].tabla = CPA_SIN_TABLA;
+    }
+
+    string cpaPath = outputPath.empty() ? carpeta + ".cpa" : outputPath;
+    ofstream out(cpaPath.c_str(), ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "No se pudo abrir el archivo de salida: " << cpaPath << "\n";
+        return false;
+    }
+
+    vector<unsigned char> header(CPA_MAGIC, CPA_MAGIC + 4);
+    header.push_back(CPA_VERSION);
+    header.push_back(fileFlags(opciones));
+    header.push_back(0);
+    header.push_back(0);
+    appendUInt(header, CPM_BLOCK_SIZE);
+    out.write((const char*)&header[0], (streamsize)header.size());
+    unsigned long long posicion = header.size();
+
+    size_t i = 0;
+    for (; i < miembros.size() && miembros[i].tamanoOriginal > CPM_BLOCK_SIZE; ++i) {
+        MappedFile entrada;
+        bool proyectado = entrada.open(rutas[i], true);
+        ifstream in;
+        if (!proyectado) in.open(rutas[i].c_str(), ios::binary);
+        if (!proyectado && !in) {
+            cerr << "No se pudo abrir el archivo de entrada: " << rutas[i] << "\n";
+            return false;
+        }
+        vector<BlockIndexEntry> indice;
+        unsigned long long originalSize = 0;
+        if (!compressBlocks(in, proyectado ? &entrada : NULL, out, posicion, opciones, indice, originalSize)) return false;
+        miembros[i].posicion = posicion;
+        miembros[i].tamanoOriginal = originalSize;
+        miembros[i].tamanoComprimido = 0;
+        for (size_t k = 0; k < indice.size(); ++k) {
+            miembros[i].tamanoComprimido += indice[k].compressedSize;
+        }
+        posicion += miembros[i].tamanoComprimido;
+    }
+
+    //un lote por archivo mediano y lotes de hasta CPA_LOTE bytes con los chicos de una misma extension
+    vector<pair<size_t, size_t> > lotes;
+    for (size_t desde = i; desde < miembros.size();) {
+        size_t hasta = desde + 1;
+        if (miembros[desde].tamanoOriginal <= CPA_ARCHIVO_CHICO) {
+            unsigned long long total = miembros[desde].tamanoOriginal;
+            string extension = getExtension(getFileName(miembros[desde].nombre));
+            while (hasta < miembros.size() && total + miembros[hasta].tamanoOriginal <= CPA_LOTE &&
+                getExtension(getFileName(miembros[hasta].nombre)) == extension) {
+                total += miembros[hasta++].tamanoOriginal;
+            }
+        }
+        lotes.push_back(make_pair(desde, hasta));
+        desde = hasta;
+    }
+
+    //anillo de lotes en transito, dos por hilo como en la compresion por bloques
+    int hilos = resolveThreadCount(opciones.hilos);
+    vector<ArchiveSlot> slots((size_t)hilos * 2);
+    for (size_t k = 0; k < slots.size(); ++k) {
+        slots[k].trabajo.stats = statsActivas ? &slots[k].stats : NULL;
+    }
+    mutex slotMutex;
+    condition_variable slotCv;
+    vector<ArchiveTable> tablas;
+    bool error = false;
+    {
+        //se declara despues de las ranuras para que sus hilos terminen antes de liberarlas
+        ThreadPool pool(hilos);
+        size_t enviados = 0;
+        size_t escritos = 0;
+        while (!error && escritos < lotes.size()) {
+            for (; enviados < lotes.size() && enviados - escritos < slots.size(); ++enviados) {
+                ArchiveSlot* tarea = &slots[enviados % slots.size()];
+                {
+                    lock_guard<mutex> lock(slotMutex);
+                    tarea->listo = false;
+                }
+                tarea->desde = lotes[enviados].first;
+                tarea->hasta = lotes[enviados].second;
+                pool.submit([tarea, &miembros, &rutas, &opciones, &slotMutex, &slotCv]() {
+                    bool ok = compressArchiveLote(miembros, rutas, opciones, *tarea);
+                    lock_guard<mutex> lock(slotMutex);
+                    tarea->ok = ok;
+                    tarea->listo = true;
+                    slotCv.notify_all();
+                });
+            }
+
+            ArchiveSlot& slot = slots[escritos % slots.size()];
+            {
+                unique_lock<mutex> lock(slotMutex);
+                while (!slot.listo) slotCv.wait(lock);
+            }
+            if (!slot.ok) {
+                cerr << slot.error << "\n";
+                error = true;
+                break;
+            }
+
+            unsigned int tabla = CPA_SIN_TABLA;
+            if (slot.usaTabla) {
+                tabla = (unsigned int)tablas.size();
+                tablas.push_back(slot.tabla);
+            }
+            unsigned long long inicio = posicion;
+            for (size_t k = slot.desde; k < slot.hasta; ++k) {
+                miembros[k].posicion = inicio;
+                miembros[k].tamanoComprimido = slot.tamanos[k - slot.desde];
+                miembros[k].tabla = tabla;
+                inicio += miembros[k].tamanoComprimido;
+            }
+            if (!slot.codificado.empty()) {
+                ScopedTimer timer(statsActivas, ETAPA_ESCRITURA);
+                out.write((const char*)&slot.codificado[0], (streamsize)slot.codificado.size());
+            }
+            if (!out) {
+                cerr << "Error escribiendo los datos comprimidos.\n";
+                error = true;
+                break;
+            }
+            posicion += slot.codificado.size();
+            escritos++;
+        }
+    }
+    if (error) return false;
+    for (size_t k = 0; k < slots.size(); ++k) {
+        mergeStats(slots[k].stats);
+    }
+
+    vector<unsigned char> directorio;
+    appendUInt(directorio, (unsigned int)tablas.size());
+    for (size_t k = 0; k < tablas.size(); ++k) {
+        appendCodeLengths(directorio, tablas[k].lengths);
+    }
+    appendUInt(directorio, (unsigned int)miembros.size());
+    for (size_t k = 0; k < miembros.size(); ++k) {
+        appendUInt(directorio, (unsigned int)miembros[k].nombre.size());
+        directorio.insert(directorio.end(), miembros[k].nombre.begin(), miembros[k].nombre.end());
+        appendULL(directorio, miembros[k].tamanoOriginal);
+        appendULL(directorio, miembros[k].posicion);
+        appendULL(directorio, miembros[k].tamanoComprimido);
+        appendUInt(directorio, miembros[k].tabla);
+    }
+    vector<unsigned char> pie;
+    appendULL(pie, posicion);
+    appendUInt(pie, (unsigned int)directorio.size());
+    appendUInt(pie, crc32c(&directorio[0], directorio.size(), 0));
+    pie.insert(pie.end(), CPA_DIRECTORY_MAGIC, CPA_DIRECTORY_MAGIC + 4);
+    {
+        ScopedTimer timer(statsActivas, ETAPA_ESCRITURA);
+        out.write((const char*)&directorio[0], (streamsize)directorio.size());
+        out.write((const char*)&pie[0], (streamsize)pie.size());
+        out.flush();
+    }
+    if (!out) {
+        cerr << "Error escribiendo los datos comprimidos.\n";
+        return false;
+    }
+
+    cout << "Carpeta empaquetada correctamente.\n";
+    cout << "Carpeta          : " << carpeta << "\n";
+    cout << "Archivo .cpa     : " << cpaPath << "\n";
+    cout << "Miembros         : " << miembros.size() << " (" << tablas.size() << " tablas compartidas)\n";
+    return true;
+}
+
+//lee header, pie y directorio de un .cpa y valida que cada miembro caiga dentro de la zona de datos
+bool readArchiveDirectory(istream& in, ArchiveDirectory& directorio) {
+    vector<unsigned char> header;
+    in.clear();
+    in.seekg(0, ios::beg);
+    if (!readExact(in, header, CPA_HEADER_SIZE) || memcmp(&header[0], CPA_MAGIC, 4) != 0) return false;
+    size_t offset = 8;
+    directorio.flags = header[5];
+    directorio.blockSize = readUInt(header, offset);
+    if (header[4] != CPA_VERSION || (directorio.flags & ~CPM_FLAGS_CONOCIDOS) != 0 || directorio.blockSize == 0 ||
+        directorio.blockSize > CPM_MAX_BLOCK_SIZE) {
+        return false;
+    }
+
+    in.seekg(0, ios::end);
+    long long fileSize = (long long)in.tellg();
+    if (fileSize < (long long)(CPA_HEADER_SIZE + CPA_FOOTER_SIZE)) return false;
+    vector<unsigned char> pie;
+    in.seekg(fileSize - (long long)CPA_FOOTER_SIZE, ios::beg);
+    if (!readExact(in, pie, CPA_FOOTER_SIZE) || memcmp(&pie[16], CPA_DIRECTORY_MAGIC, 4) != 0) return false;
+    offset = 0;
+    unsigned long long posicionDirectorio = readULL(pie, offset);
+    unsigned int tamano = readUInt(pie, offset);
+    unsigned int crc = readUInt(pie, offset);
+    if (posicionDirectorio < CPA_HEADER_SIZE || posicionDirectorio + tamano + CPA_FOOTER_SIZE != (unsigned long long)fileSize) return false;
+
+    vector<unsigned char> datos;
+    in.seekg((long long)posicionDirectorio, ios::beg);
+    if (!readExact(in, datos, tamano) || tamano < 8 || crc32c(&datos[0], datos.size(), 0) != crc) return false;
+
+    offset = 0;
+    unsigned int cantidadTablas = readUInt(datos, offset);
+    //cada tabla ocupa al menos un byte, asi un contador danado no reserva memoria de mas
+    if (cantidadTablas > datos.size() - offset) return false;
+    directorio.tablas.resize(cantidadTablas);
+    for (unsigned int t = 0; t < cantidadTablas; ++t) {
+        if (!readCodeLengths(&datos[0], datos.size(), offset, directorio.tablas[t].lengths)) return false;
+    }
+    if (datos.size() - offset < 4) return false;
+    unsigned int cantidad = readUInt(datos, offset);
+    if (cantidad > (datos.size() - offset) / 32) return false;
+    directorio.miembros.resize(cantidad);
+    for (unsigned int k = 0; k < cantidad; ++k) {
+        ArchiveMember& miembro = directorio.miembros[k];
+        if (datos.size() - offset < 4) return false;
+        unsigned int largo = readUInt(datos, offset);
+        if (largo > datos.size() - offset || datos.size() - offset - largo < 28) return false;
+        miembro.nombre.assign(datos.begin() + offset, datos.begin() + offset + largo);
+        offset += largo;
+        miembro.tamanoOriginal = readULL(datos, offset);
+        miembro.posicion = readULL(datos, offset);
+        miembro.tamanoComprimido = readULL(datos, offset);
+        miembro.tabla = readUInt(datos, offset);
+        if (miembro.posicion < CPA_HEADER_SIZE || miembro.tamanoComprimido > posicionDirectorio - miembro.posicion ||
+            miembro.posicion > posicionDirectorio || (miembro.tabla != CPA_SIN_TABLA && miembro.tabla >= cantidadTablas)) {
+            return false;
+        }
+    }
+    return offset == datos.size();
+}
+
+//extrae de un .cpa el miembro llamado miembro, o todos si esta vacio, dentro de la carpeta destino
+//(por defecto CarpetaX junto al .cpa); con un solo miembro destino "-" es la salida estandar
+//cada hilo toma el siguiente miembro libre y decodifica sus bloques en orden; la tabla compartida de un
+//lote se arma una vez y sirve para todos sus miembros
+//con verificar no se escribe nada: se decodifica cada miembro y se informan los danados
+bool extractArchive(const string& cpaPath, const string& miembro, const string& destinoPath, int threads, bool verificar) {
+    ifstream in(cpaPath.c_str(), ios::binary);
+    if (!in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << cpaPath << "\n";
+        return false;
+    }
+    ArchiveDirectory directorio;
+    if (!readArchiveDirectory(in, directorio)) {
+        cerr << "Directorio del archivo .cpa invalido o danado.\n";
+        return false;
+    }
+    in.close();
+
+    vector<size_t> seleccion;
+    for (size_t k = 0; k < directorio.miembros.size(); ++k) {
+        if (!safeMemberName(directorio.miembros[k].nombre)) {
+            cerr << "Nombre de miembro no valido en el archivo .cpa: " << directorio.miembros[k].nombre << "\n";
+            return false;
+        }
+        if (miembro.empty() || directorio.miembros[k].nombre == miembro) seleccion.push_back(k);
+    }
+    if (!miembro.empty() && seleccion.empty()) {
+        cerr << "El archivo .cpa no contiene el miembro: " << miembro << "\n";
+        return false;
+    }
+
+    bool salidaEstandar = destinoPath == "-";
+    if (salidaEstandar && seleccion.size() != 1) {
+        cerr << "La salida estandar solo admite un miembro a la vez.\n";
+        return false;
+    }
+    if (salidaEstandar) prepareStandardStreams();
+    string destino = destinoPath.empty() ? getDirectory(cpaPath) + getBaseName(getFileName(cpaPath)) : destinoPath;
+
+    MappedFile entrada;
+    bool proyectado = entrada.open(cpaPath, false);
+    CpmHeader header;
+    header.blockSize = directorio.blockSize;
+    header.flags = directorio.flags;
+    bool checksum = (directorio.flags & CPM_FLAG_CRC32C) != 0;
+
+    atomic<size_t> siguiente(0);
+    atomic<bool> error(false);
+    mutex fallidosMutex;
+    vector<string> fallidos;
+
+    function<void()> worker = [&]() {
+        ifstream archivo;
+        if (!proyectado) archivo.open(cpaPath.c_str(), ios::binary);
+        if (!proyectado && !archivo) {
+            error = true;
+            return;
+        }
+        vector<unsigned char> prefijo;
+        vector<unsigned char> codificado;
+        vector<unsigned char> salida;
+        BlockDecoder decoder;
+        CodecStats parcial;
+        CodecStats* stats = statsActivas ? &parcial : NULL;
+        decoder.stats = stats;
+        HuffmanDecoder compartida;
+        unsigned int tablaArmada = CPA_SIN_TABLA;
+
+        while (!error) {
+            size_t i = siguiente++;
+            if (i >= seleccion.size()) break;
+            const ArchiveMember& actual = directorio.miembros[seleccion[i]];
+
+            bool valido = true;
+            if (actual.tabla != CPA_SIN_TABLA && actual.tabla != tablaArmada) {
+                ScopedTimer timer(stats, ETAPA_TABLAS);
+                CodeTable codes;
+                valido = buildCanonicalCodes(directorio.tablas[actual.tabla].lengths, codes) && buildDecoder(codes, compartida);
+                tablaArmada = valido ? actual.tabla : CPA_SIN_TABLA;
+            }
+            decoder.tablaExterna = actual.tabla != CPA_SIN_TABLA ? &compartida : NULL;
+
+            ofstream archivoSalida;
+            ostream* out = NULL;
+            if (!verificar && salidaEstandar) {
+                out = &cout;
+            }
+            else if (!verificar) {
+                string ruta = destino + "/" + actual.nombre;
+                createParentDirectories(ruta);
+                archivoSalida.open(ruta.c_str(), ios::binary | ios::trunc);
+                if (!archivoSalida) {
+                    lock_guard<mutex> lock(fallidosMutex);
+                    cerr << "No se pudo abrir el archivo de salida: " << ruta << "\n";
+                    error = true;
+                    break;
+                }
+                out = &archivoSalida;
+            }
+
+            unsigned long long posicion = actual.posicion;
+            unsigned long long fin = actual.posicion + actual.tamanoComprimido;
+            unsigned long long producidos = 0;
+            while (valido && posicion < fin) {
+                const unsigned char* bloque = NULL;
+                size_t encodedSize = 0;
+                unsigned int rawSize = 0;
+                if (fin - posicion < 8) {
+                    valido = false;
+                    break;
+                }
+                if (proyectado) {
+                    size_t offset = 0;
+                    bloque = entrada.data() + posicion;
+                    rawSize = readUInt(bloque, 8, offset);
+                    encodedSize = readUInt(bloque, 8, offset);
+                    bloque += 8;
+                }
+                else {
+                    ScopedTimer timer(stats, ETAPA_LECTURA);
+                    archivo.clear();
+                    archivo.seekg((streamoff)posicion, ios::beg);
+                    valido = readBlock(archivo, header, prefijo, codificado, rawSize);
+                    bloque = codificado.data();
+                    encodedSize = codificado.size();
+                }
+                valido = valido && rawSize > 0 && rawSize <= directorio.blockSize && encodedSize <= fin - posicion - 8;
+                if (!valido) break;
+
+                salida.resize(rawSize);
+                valido = decodeBlock(bloque, encodedSize, rawSize, &salida[0], decoder, checksum);
+                if (valido && out) {
+                    ScopedTimer timer(stats, ETAPA_ESCRITURA);
+                    out->write((const char*)&salida[0], (streamsize)rawSize);
+                    valido = !out->fail();
+                }
+                posicion += 8 + encodedSize;
+                producidos += rawSize;
+            }
+            if (out) out->flush();
+            valido = valido && posicion == fin && producidos == actual.tamanoOriginal && (!out || !out->fail());
+
+            if (!valido) {
+                lock_guard<mutex> lock(fallidosMutex);
+                fallidos.push_back(actual.nombre);
+                //al verificar se sigue con los demas miembros para informarlos todos
+                if (!verificar) error = true;
+            }
+        }
+        mergeStats(parcial);
+    };
+
+    int hilos = resolveThreadCount(threads);
+    if (salidaEstandar) hilos = 1;
+    if ((size_t)hilos > seleccion.size()) hilos = seleccion.empty() ? 1 : (int)seleccion.size();
+    vector<thread> workers;
+    for (int k = 1; k < hilos; ++k) {
+        workers.push_back(thread(worker));
+    }
+    worker();
+    for (size_t k = 0; k < workers.size(); ++k) {
+        workers[k].join();
+    }
+
+    if (!fallidos.empty()) {
+        sort(fallidos.begin(), fallidos.end());
+        for (size_t k = 0; k < fallidos.size(); ++k) {
+            cerr << "Miembro danado: " << fallidos[k] << "\n";
+        }
+        if (verificar) cerr << "Verificacion fallida: " << fallidos.size() << " de " << seleccion.size() << " miembros danados.\n";
+        else cerr << "Datos comprimidos incompletos o danados.\n";
+        return false;
+    }
+    if (error) return false;
+    if (salidaEstandar) return true;
+
+    unsigned long long total = 0;
+    for (size_t k = 0; k < seleccion.size(); ++k) {
+        total += directorio.miembros[seleccion[k]].tamanoOriginal;
+    }
+    if (verificar) {
+        if (!checksum) {
+            cout << "Aviso: el archivo no guarda crc por bloque, solo se comprueba que cada bloque se pueda decodificar.\n";
+        }
+        cout << "Archivo verificado correctamente.\n";
+        cout << "Archivo .cpa     : " << cpaPath << "\n";
+    }
+    else {
+        cout << "Archivo desempaquetado correctamente.\n";
+        cout << "Archivo .cpa     : " << cpaPath << "\n";
+        cout << "Carpeta destino  : " << destino << "\n";
+    }
+    cout << "Miembros         : " << seleccion.size() << "\n";
+    cout << "Bytes originales : " << total << "\n";
+    return true;
+}
+
+//muestra el directorio de un .cpa: tamano original, tamano comprimido y nombre de cada miembro
+bool listArchive(const string& cpaPath) {
+    ifstream in(cpaPath.c_str(), ios::binary);
+    if (!in) {
+        cerr << "No se pudo abrir el archivo de entrada: " << cpaPath << "\n";
+        return false;
+    }
+    ArchiveDirectory directorio;
+    if (!readArchiveDirectory(in, directorio)) {
+        cerr << "Directorio del archivo .cpa invalido o danado.\n";
+        return false;
+    }
+
+    unsigned long long original = 0;
+    unsigned long long comprimido = 0;
+    for (size_t k = 0; k < directorio.miembros.size(); ++k) {
+        const ArchiveMember& miembro = directorio.miembros[k];
+        cout << miembro.tamanoOriginal << "\t" << miembro.tamanoComprimido << "\t" << miembro.nombre << "\n";
+        original += miembro.tamanoOriginal;
+        comprimido += miembro.tamanoComprimido;
+    }
+    cout << "Miembros: " << directorio.miembros.size() << ", tablas compartidas: " << directorio.tablas.size()
+         << ", bytes originales: " << original << ", bytes comprimidos: " << comprimido << "\n";
+    return true;
+}
+
+//comando -c: comprime entrada en salida, donde "-" es la entrada o salida estandar
+//si algun extremo es estandar no se muestran mensajes informativos para no mezclarlos con los datos
+bool compressCommand(const string& entrada, const string& salida, const CompressOptions& opciones) {
+    if (entrada != "-" && salida != "-") return compressFile(entrada, opciones, salida);
+    prepareStandardStreams();
+
+    istream* in = &cin;
+    ifstream archivoEntrada;
+    MappedFile mapa;
+    const MappedFile* proyectado = NULL;
+    //la entrada estandar no tiene nombre, el .cpm se guarda sin nombre original
+    string fileName;
+    if (entrada != "-") {
+        if (mapa.open(entrada, true)) {
+            proyectado = &mapa;
+        }
+        else {
+            archivoEntrada.open(entrada.c_str(), ios::binary);
+            if (!archivoEntrada) {
+                cerr << "No se pudo abrir el archivo de entrada: " << entrada << "\n";
+                return false;
+            }
+            in = &archivoEntrada;
+        }
+        fileName = getFileName(entrada);
+    }
+
+    ostream* out = &cout;
+    ofstream archivoSalida;
+    if (salida != "-") {
+        archivoSalida.open(salida.c_str(), ios::binary | ios::trunc);
+        if (!archivoSalida) {
+            cerr << "No se pudo abrir el archivo de salida: " << salida << "\n";
+            return false;
+        }
+        out = &archivoSalida;
+    }
+    return compressStream(*in, proyectado, *out, fileName, opciones);
+}
+
+//comando train: entrena un diccionario con los archivos indicados (de cada carpeta, todos los de adentro)
+//y lo guarda en outputPath, por defecto diccionario.cpd; los archivos se leen por bloques y solo se cuentan
+bool trainCommand(const vector<string>& entradas, const CompressOptions& opciones, const string& outputPath) {
+    vector<string> rutas;
+    for (size_t i = 0; i < entradas.size(); ++i) {
+        vector<ArchiveMember> miembros;
+        vector<string> encontradas;
+        //lo que no se puede recorrer como carpeta se toma como archivo
+        if (listFiles(entradas[i], "", miembros, encontradas)) rutas.insert(rutas.end(), encontradas.begin(), encontradas.end());
+        else rutas.push_back(entradas[i]);
+    }
+
+    unsigned long long freqs[256] = { 0 };
+    unsigned long long parcial[256];
+    unsigned long long total = 0;
+    vector<unsigned char> buffer(CPM_BLOCK_SIZE);
+    for (size_t i = 0; i < rutas.size(); ++i) {
+        ifstream in(rutas[i].c_str(), ios::binary);
+        if (!in) {
+            cerr << "No se pudo abrir el archivo de entrada: " << rutas[i] << "\n";
+            return false;
+        }
+        while (in) {
+            in.read((char*)&buffer[0], (streamsize)buffer.size());
+            size_t leidos = (size_t)in.gcount();
+            countFrequencies(&buffer[0], leidos, parcial);
+            for (int k = 0; k < 256; ++k) freqs[k] += parcial[k];
+            total += leidos;
+        }
+    }
+    if (total == 0) {
+        cerr << "No hay datos de muestra para entrenar el diccionario.\n";
+        return false;
+    }
+
+    Dictionary diccionario;
+    vector<unsigned char> datos;
+    if (!buildDictionary(freqs, opciones.maxLongitud, diccionario)) {
+        cerr << "No se pudo construir el arbol de Huffman.\n";
+        return false;
+    }
+    saveDictionary(diccionario, datos);
+    string outputName = outputPath.empty() ? "diccionario.cpd" : outputPath;
+    if (!writeFile(outputName, datos)) return false;
+
+    cout << "Diccionario entrenado correctamente.\n";
+    cout << "Archivos de muestra : " << rutas.size() << "\n";
+    cout << "Bytes de muestra    : " << total << "\n";
+    cout << "Id del diccionario  : " << dictionaryName(diccionario.id) << "\n";
+    cout << "Archivo .cpd        : " << outputName << "\n";
+    return true;
+}
+
+//carga el diccionario de --dict y arma sus tablas, una sola vez para todo el programa
+bool loadDictionaryFile(const string& path, Dictionary& diccionario) {
+    vector<unsigned char> datos;
+    if (!readFile(path, datos)) return false;
+    if (!loadDictionary(&datos[0], datos.size(), diccionario)) {
+        cerr << "Diccionario invalido o danado: " << path << "\n";
+        return false;
+    }
+    return true;
+}
+
+//comando -d: descomprime entrada en salida, donde "-" es la entrada o salida estandar
+//entre archivos se usa el indice y varios hilos; con algun extremo estandar los bloques se procesan en orden
+bool decompressCommand(const string& entrada, const string& salida, int threads) {
+    if (entrada != "-" && salida != "-") return decompressFile(entrada, threads, salida);
+    prepareStandardStreams();
+
+    istream* in = &cin;
+    ifstream archivoEntrada;
+    if (entrada != "-") {
+        archivoEntrada.open(entrada.c_str(), ios::binary);
+        if (!archivoEntrada) {
+            cerr << "No se pudo abrir el archivo de entrada: " << entrada << "\n";
+            return false;
+        }
+        in = &archivoEntrada;
+    }
+
+    ostream* out = &cout;
+    ofstream archivoSalida;
+    if (salida != "-") {
+        archivoSalida.open(salida.c_str(), ios::binary | ios::trunc);
+        if (!archivoSalida) {
+            cerr << "No se pudo abrir el archivo de salida: " << salida << "\n";
+            return false;
+        }
+        out = &archivoSalida;
+    }
+    return decompressStream(*in, *out);
+}
+
+//pico de memoria residente del proceso en KiB, 0 si el sistema no lo informa
+unsigned long long peakRssKb() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS contadores;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &contadores, sizeof(contadores))) {
+        return (unsigned long long)contadores.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#elif defined(__linux__) || defined(__APPLE__)
+    struct rusage uso;
+    if (getrusage(RUSAGE_SELF, &uso) != 0) return 0;
+#if defined(__APPLE__)
+    //en macOS ru_maxrss esta en bytes
+    return (unsigned long long)uso.ru_maxrss / 1024;
+#else
+    return (unsigned long long)uso.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+//nombres de los modos de bloque, en el orden de sus valores
+const char* const NOMBRES_MODOS[CPM_MODOS] = { "un_flujo", "cuatro_flujos", "sin_comprimir", "repetido", "lz77", "tabla_externa", "tabla_nueva" };
+
+//muestra el desglose por etapa, la velocidad y el pico de memoria de una operacion
+//va a la salida de errores porque la salida estandar puede llevar los datos; con jsonPath se guarda tambien en json
+void printStats(const CodecStats& stats, double segundos, const string& jsonPath) {
+    unsigned long long totalNanos = 0;
+    unsigned long long bloques = 0;
+    for (int e = 0; e < CPM_ETAPAS; ++e) totalNanos += stats.nanos[e];
+    for (int m = 0; m < CPM_MODOS; ++m) bloques += stats.bloques[m];
+    double velocidad = segundos > 0 ? (double)stats.bytesOriginales / segundos / 1e6 : 0;
+    unsigned long long pico = peakRssKb();
+
+    cerr << "\n--- ESTADISTICAS ---\n";
+    cerr << "Tiempo total      : " << segundos << " s\n";
+    cerr << "Bytes originales  : " << stats.bytesOriginales << "\n";
+    cerr << "Bytes codificados : " << stats.bytesCodificados;
+    if (stats.bytesOriginales > 0) cerr << " (" << 100.0 * stats.bytesCodificados / stats.bytesOriginales << "%)";
+    cerr << "\n";
+    cerr << "Velocidad         : " << velocidad << " MB/s\n";
+    cerr << "Pico de memoria   : " << pico << " KiB\n";
+    cerr << "Bloques           : " << bloques;
+    for (int m = 0; m < CPM_MODOS; ++m) {
+        if (stats.bloques[m] > 0) cerr << " " << NOMBRES_MODOS[m] << "=" << stats.bloques[m];
+    }
+    cerr << "\n";
+    cerr << "Simbolos huffman  : " << stats.simbolos << "\n";
+    //con varios hilos las etapas se suman entre todos y pueden superar el tiempo total
+    cerr << "Etapas (ms, suma de todos los hilos):\n";
+    for (int e = 0; e < CPM_ETAPAS; ++e) {
+        if (stats.nanos[e] == 0) continue;
+        cerr << "  " << CPM_NOMBRES_ETAPAS[e] << string(16 - strlen(CPM_NOMBRES_ETAPAS[e]), ' ') << stats.nanos[e] / 1e6
+             << " ms (" << 100.0 * stats.nanos[e] / totalNanos << "%)\n";
+    }
+
+    if (jsonPath.empty()) return;
+    ofstream out(jsonPath.c_str(), ios::trunc);
+    out << "{\"segundos\": " << segundos
+        << ", \"bytes_originales\": " << stats.bytesOriginales
+        << ", \"bytes_codificados\": " << stats.bytesCodificados
+        << ", \"mb_s\": " << velocidad
+        << ", \"pico_rss_kb\": " << pico
+        << ", \"simbolos\": " << stats.simbolos
+        << ", \"bloques\": {";
+    for (int m = 0; m < CPM_MODOS; ++m) {
+        out << (m ? ", " : "") << "\"" << NOMBRES_MODOS[m] << "\": " << stats.bloques[m];
+    }
+    out << "}, \"etapas_ms\": {";
+    for (int e = 0; e < CPM_ETAPAS; ++e) {
+        out << (e ? ", " : "") << "\"" << CPM_NOMBRES_ETAPAS[e] << "\": " << stats.nanos[e] / 1e6;
+    }
+    out << "}}\n";
+    if (!out) cerr << "No se pudo escribir el archivo de estadisticas: " << jsonPath << "\n";
+}
+
+//ejecuta una operacion y, si se pidio --stats, informa lo que midio
+bool runWithStats(const function<bool()>& operacion, const string& statsJson) {
+    if (!statsActivas) return operacion();
+    statsActivas->reset();
+    chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+    bool ok = operacion();
+    printStats(*statsActivas, chrono::duration<double>(chrono::steady_clock::now() - inicio).count(), statsJson);
+    return ok;
+}
+
+//muestra las opciones de linea de comandos aceptadas
+void printUsage(const char* programa) {
+    cerr << "Uso: " << programa << " [-T hilos] [-L bits] [-S flujos] [-Z nivel] [-W bits] [-A umbral] [--stats]\n";
+    cerr << "     " << programa << " -c [opciones] [entrada|-] [-o salida|-]\n";
+    cerr << "     " << programa << " -d [-T hilos] [entrada.cpm|-] [-o salida|-]\n";
+    cerr << "     " << programa << " extract archivo.cpm --offset X [--length Y] [-o salida]\n";
+    cerr << "     " << programa << " verify [-T hilos] archivo.cpm|archivo.cpa\n";
+    cerr << "     " << programa << " archive [opciones] carpeta [-o salida.cpa]\n";
+    cerr << "     " << programa << " -d [-T hilos] archivo.cpa [--member nombre] [-o carpeta|-]\n";
+    cerr << "     " << programa << " list archivo.cpa\n";
+    cerr << "     " << programa << " train [-L bits] muestra... [-o diccionario.cpd]\n";
+    cerr << "  -c           comprime sin menu; sin entrada o con \"-\" lee la entrada estandar\n";
+    cerr << "  -d           descomprime sin menu; sin entrada o con \"-\" lee la entrada estandar\n";
+    cerr << "  verify       comprueba el crc de cada bloque de un .cpm sin escribir ninguna salida\n";
+    cerr << "  archive      empaqueta una carpeta completa en un .cpa, comprimiendo varios archivos a la vez\n";
+    cerr << "  list         muestra los miembros de un .cpa\n";
+    cerr << "  train        arma un diccionario con las frecuencias de los archivos (o carpetas) de muestra\n";
+    cerr << "  --dict X     comprime con el diccionario X, o lo usa para leer un .cpm comprimido con el (no con archive ni -A)\n";
+    cerr << "  --member X   con -d extrae solo el miembro X de un .cpa (\"-o -\" lo escribe en la salida estandar)\n";
+    cerr << "  -T N         cantidad de hilos para comprimir y descomprimir (0 usa todos los nucleos, por defecto 1)\n";
+    cerr << "  -L N         longitud maxima de cada codigo, entre " << MIN_MAX_CODE_LENGTH << " y " << BIT_WRITER_MAX_BITS
+         << " bits (por defecto " << DEFAULT_MAX_CODE_LENGTH << ")\n";
+    cerr << "  -S N         flujos de bits por bloque: 4 (por defecto) o 1\n";
+    cerr << "  -Z N         nivel de la etapa lz77, de 1 (rapido) a " << LZ_NIVEL_MAXIMO << " (mayor compresion); 0 la desactiva (por defecto)\n";
+    cerr << "  -W N         ventana lz77 en bits, entre " << LZ_VENTANA_MIN << " y " << LZ_VENTANA_MAX
+         << " (por defecto " << LZ_VENTANA_DEFECTO << ", " << (1 << (LZ_VENTANA_DEFECTO - 10)) << " KiB)\n";
+    cerr << "  -A N         una pasada: la tabla de cada bloque sale de una muestra y se reutiliza mientras\n";
+    cerr << "               ocupe a lo sumo N% mas que una nueva (1 a 100; 0 lo desactiva, por defecto); sin -Z\n";
+    cerr << "  --stats      al terminar muestra el tiempo de cada etapa, la velocidad y el pico de memoria\n";
+    cerr << "  --stats-json archivo   ademas guarda esas estadisticas en json\n";
+    cerr << "  --offset X   primer byte original a extraer\n";
+    cerr << "  --length Y   cantidad de bytes a extraer, por defecto hasta el final\n";
+    cerr << "  -o salida    archivo de salida, \"-\" es la salida estandar; si se lee de la entrada estandar\n";
+    cerr << "               la salida estandar es la opcion por defecto\n";
+}
+
+//menu interactivo basico para elegir operacion
+void runMenu(const CompressOptions& opciones, const string& statsJson) {
+    cout << "============================================\n";
+    cout << "  COMPRESOR / DESCOMPRESOR HUFFMAN (.cpm)\n";
+    cout << "============================================\n";
+    cout << "Hilos de trabajo: " << opciones.hilos << "\n";
+    cout << "Longitud maxima de codigo: " << opciones.maxLongitud << " bits\n";
+    cout << "Flujos por bloque: " << opciones.flujos << "\n";
+    cout << "Nivel lz77: " << opciones.nivelLz << " (ventana de " << (1 << opciones.ventanaLz) << " bytes)\n";
+    cout << "Umbral de tabla reutilizada: " << opciones.umbralTabla << "% (0 desactiva el modo de una pasada)\n";
+    cout << "Diccionario: " << (opciones.diccionario ? dictionaryName(opciones.diccionario->id) : string("ninguno")) << "\n\n";
+
+    int opcion;
+    string entrada;
+
+    do {
+        //muestra las opciones disponibles y lee la accion del usuario
+        cout << "\nMENU:\n";
+        cout << "1. Comprimir archivo (ArchivoX.ext -> ArchivoX.cpm)\n";
+        cout << "2. Descomprimir archivo (ArchivoX.cpm -> ArchivoX-descomprimido.ext, CarpetaX.cpa -> CarpetaX)\n";
+        cout << "3. Verificar archivo comprimido (.cpm o .cpa)\n";
+        cout << "4. Empaquetar carpeta (CarpetaX -> CarpetaX.cpa)\n";
+        cout << "0. Salir\n";
+        cout << "Seleccione una opcion: ";
+
+        if (!(cin >> opcion)) {
+            cin.clear();
+            cin.ignore(10000, '\n');
+            cout << "Entrada invalida. Intente de nuevo.\n";
+            continue;
+        }
+
+        switch (opcion) {
+        case 1:
+            cout << "\n--- COMPRESION ---\n";
+            cout << "Ingrese ruta del archivo a comprimir (ArchivoX.ext): ";
+            cin >> entrada;
+            if (!runWithStats([&]() { return compressFile(entrada, opciones, ""); }, statsJson)) {
+                cout << "Ocurrio un error al comprimir.\n";
+            }
+            break;
+
+        case 2:
+            cout << "\n--- DESCOMPRESION ---\n";
+            cout << "Ingrese ruta del archivo comprimido (.cpm): ";
+            cin >> entrada;
+            if (!runWithStats([&]() { return decompressFile(entrada, opciones.hilos, ""); }, statsJson)) {
+                cout << "Ocurrio un error al descomprimir.\n";
+            }
+            break;
+
+        case 3:
+            cout << "\n--- VERIFICACION ---\n";
+            cout << "Ingrese ruta del archivo comprimido (.cpm): ";
+            cin >> entrada;
+            if (!runWithStats([&]() { return verifyFile(entrada, opciones.hilos); }, statsJson)) {
+                cout << "El archivo no paso la verificacion.\n";
+            }
+            break;
+
+        case 4:
+            cout << "\n--- EMPAQUETADO ---\n";
+            cout << "Ingrese ruta de la carpeta a empaquetar: ";
+            cin >> entrada;
+            if (!runWithStats([&]() { return compressArchive(entrada, opciones, ""); }, statsJson)) {
+                cout << "Ocurrio un error al empaquetar.\n";
+            }
+            break;
+
+        case 0:
+            cout << "Saliendo del programa...\n";
+            break;
+
+        default:
+            cout << "Opcion no valida. Intente nuevamente.\n";
+            break;
+        }
+
+    } while (opcion != 0);
+}
+
+//punto de entrada: sin comandos abre el menu interactivo, con -c o -d comprime o descomprime sin menu
+//(tambien entre la entrada y salida estandar), con "extract" recupera un rango, con "verify" comprueba un .cpm
+//y con "archive" y "list" empaqueta una carpeta en un .cpa o muestra su contenido
+//las opciones de linea de comandos ajustan como se ejecutan las operaciones
+int main(int argc, char* argv[]) {
+    CompressOptions opciones;
+    unsigned long long rangoInicio = 0;
+    unsigned long long rangoLargo = ~0ULL;
+    bool tieneInicio = false;
+    //'c' o 'd' cuando se pide comprimir o descomprimir sin menu
+    char modo = 0;
+    string salida;
+    vector<string> posicionales;
+    //miembro de un .cpa a extraer con -d
+    string miembro;
+    bool conStats = false;
+    string statsJson;
+    string diccionarioPath;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool conValor = i + 1 < argc;
+        if (arg == "-T" && conValor) {
+            opciones.hilos = resolveThreadCount(atoi(argv[++i]));
+        }
+        else if (arg == "-L" && conValor) {
+            opciones.maxLongitud = atoi(argv[++i]);
+            if (opciones.maxLongitud < MIN_MAX_CODE_LENGTH || opciones.maxLongitud > BIT_WRITER_MAX_BITS) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-S" && conValor) {
+            opciones.flujos = atoi(argv[++i]);
+            if (opciones.flujos != 1 && opciones.flujos != CPM_FLUJOS) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-Z" && conValor) {
+            opciones.nivelLz = atoi(argv[++i]);
+            if (opciones.nivelLz < 0 || opciones.nivelLz > LZ_NIVEL_MAXIMO) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-W" && conValor) {
+            opciones.ventanaLz = atoi(argv[++i]);
+            if (opciones.ventanaLz < LZ_VENTANA_MIN || opciones.ventanaLz > LZ_VENTANA_MAX) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "-A" && conValor) {
+            opciones.umbralTabla = atoi(argv[++i]);
+            if (opciones.umbralTabla < 0 || opciones.umbralTabla > 100) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (arg == "--offset" && conValor && parseNumber(argv[i + 1], rangoInicio)) {
+            tieneInicio = true;
+            ++i;
+        }
+        else if (arg == "--length" && conValor && parseNumber(argv[i + 1], rangoLargo)) {
+            ++i;
+        }
+        else if (arg == "--stats") {
+            conStats = true;
+        }
+        else if (arg == "--stats-json" && conValor) {
+            conStats = true;
+            statsJson = argv[++i];
+        }
+        else if (arg == "--dict" && conValor) {
+            diccionarioPath = argv[++i];
+        }
+        else if (arg == "--member" && conValor) {
+            miembro = argv[++i];
+        }
+        else if (arg == "-o" && conValor) {
+            salida = argv[++i];
+        }
+        else if ((arg == "-c" || arg == "-d") && modo == 0) {
+            modo = arg[1];
+        }
+        else if (arg == "-" || (!arg.empty() && arg[0] != '-')) {
+            posicionales.push_back(arg);
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    //el modo de una pasada no recorre el bloque completo antes de codificarlo, y lz77 si lo necesita
+    if (opciones.umbralTabla > 0 && opciones.nivelLz > 0) {
+        cerr << "-A y -Z no se pueden combinar.\n";
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    //las tablas del diccionario se arman aca y sirven para todos los bloques y todos los hilos
+    Dictionary diccionario;
+    if (!diccionarioPath.empty()) {
+        if (opciones.umbralTabla > 0 || (!posicionales.empty() && posicionales[0] == "archive")) {
+            cerr << "--dict no se puede combinar con -A ni con archive.\n";
+            printUsage(argv[0]);
+            return 1;
+        }
+        if (!loadDictionaryFile(diccionarioPath, diccionario)) return 1;
+        opciones.diccionario = &diccionario;
+        diccionarioActivo = &diccionario;
+    }
+
+    CodecStats stats;
+    if (conStats) statsActivas = &stats;
+
+    if (modo != 0) {
+        if (posicionales.size() > 1) {
+            printUsage(argv[0]);
+            return 1;
+        }
+        string entrada = posicionales.empty() ? "-" : posicionales[0];
+        if (!miembro.empty()) {
+            if (modo != 'd' || entrada == "-") {
+                printUsage(argv[0]);
+                return 1;
+            }
+            return runWithStats([&]() { return extractArchive(entrada, miembro, salida, opciones.hilos, false); }, statsJson) ? 0 : 1;
+        }
+        //desde la entrada estandar no hay nombre del que derivar la salida
+        if (salida.empty() && entrada == "-") salida = "-";
+        bool ok = runWithStats([&]() {
+            return modo == 'c' ? compressCommand(entrada, salida, opciones) : decompressCommand(entrada, salida, opciones.hilos);
+        }, statsJson);
+        return ok ? 0 : 1;
+    }
+
+    if (posicionales.empty()) {
+        runMenu(opciones, statsJson);
+        return 0;
+    }
+
+    if (posicionales[0] == "extract" && posicionales.size() == 2 && tieneInicio) {
+        return runWithStats([&]() { return extractFile(posicionales[1], rangoInicio, rangoLargo, salida); }, statsJson) ? 0 : 1;
+    }
+
+    if (posicionales[0] == "verify" && posicionales.size() == 2) {
+        return runWithStats([&]() { return verifyFile(posicionales[1], opciones.hilos); }, statsJson) ? 0 : 1;
+    }
+
+    if (posicionales[0] == "archive" && posicionales.size() == 2) {
+        return runWithStats([&]() { return compressArchive(posicionales[1], opciones, salida); }, statsJson) ? 0 : 1;
+    }
+
+    if (posicionales[0] == "list" && posicionales.size() == 2) {
+        return listArchive(posicionales[1]) ? 0 : 1;
+    }
+
+    if (posicionales[0] == "train" && posicionales.size() >= 2) {
+        vector<string> muestras(posicionales.begin() + 1, posicionales.end());
+        return runWithStats([&]() { return trainCommand(muestras, opciones, salida); }, statsJson) ? 0 : 1;
+    }
+
+    printUsage(argv[0]);
+    return 1;
 }
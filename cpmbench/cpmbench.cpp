@@ -0,0 +1,508 @@
+//cpmbench: mide velocidad y compresion de libcpm sobre un corpus generado (siempre el mismo para una
+//semilla dada) o sobre archivos propios, e informa MB/s, proporcion, pico de memoria y tiempo por etapa
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <chrono>
+#include <algorithm>
+
+#include "cpm.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "psapi.lib")
+#endif
+#elif defined(__linux__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+//generador xorshift64*: a diferencia de las distribuciones de <random>, da la misma secuencia
+//en todos los compiladores, por eso el corpus es reproducible
+class Rng {
+public:
+    explicit Rng(unsigned long long semilla) : estado(semilla ? semilla : 0x9E3779B97F4A7C15ULL) {
+    }
+
+    unsigned long long next() {
+        estado ^= estado >> 12;
+        estado ^= estado << 25;
+        estado ^= estado >> 27;
+        return estado * 0x2545F4914F6CDD1DULL;
+    }
+
+    //entero en [0, n)
+    unsigned int below(unsigned int n) {
+        return (unsigned int)((next() >> 32) % n);
+    }
+
+private:
+    unsigned long long estado;
+};
+
+//bytes uniformes, el peor caso de huffman: cada bloque termina guardado sin comprimir
+void generateRandom(vector<unsigned char>& datos, size_t size, Rng& rng) {
+    datos.resize(size);
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long v = rng.next();
+        memcpy(&datos[i], &v, 8);
+    }
+    for (; i < size; ++i) {
+        datos[i] = (unsigned char)rng.next();
+    }
+}
+
+//lineas de registro con palabras de frecuencia desigual (ley de Zipf), numeros y marcas de tiempo
+void generateText(vector<unsigned char>& datos, size_t size, Rng& rng) {
+    static const char* const palabras[] = {
+        "el", "de", "la", "que", "en", "usuario", "solicitud", "error", "conexion", "servidor",
+        "archivo", "bloque", "tiempo", "estado", "respuesta", "cliente", "datos", "proceso", "memoria", "disco",
+        "lectura", "escritura", "reintento", "cancelado", "completado", "pendiente", "registro", "sesion", "token", "cache",
+        "indice", "consulta", "tabla", "columna", "nodo", "replica", "latencia", "cola", "mensaje", "evento"
+    };
+    const int cantidad = (int)(sizeof(palabras) / sizeof(palabras[0]));
+    static const char* const niveles[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+
+    //pesos acumulados 1/(k+1) para elegir palabras segun Zipf
+    vector<double> acumulado(cantidad);
+    double suma = 0;
+    for (int k = 0; k < cantidad; ++k) {
+        suma += 1.0 / (k + 1);
+        acumulado[k] = suma;
+    }
+
+    datos.clear();
+    datos.reserve(size + 256);
+    unsigned long long marca = 1700000000000ULL;
+    char linea[64];
+    while (datos.size() < size) {
+        marca += rng.below(5000);
+        int largo = snprintf(linea, sizeof(linea), "%llu [%s] hilo=%u ", marca, niveles[rng.below(6)], rng.below(32));
+        datos.insert(datos.end(), linea, linea + largo);
+
+        int cuantas = 4 + (int)rng.below(12);
+        for (int w = 0; w < cuantas; ++w) {
+            double x = (double)(rng.next() >> 11) / 9007199254740992.0 * suma;
+            int k = (int)(lower_bound(acumulado.begin(), acumulado.end(), x) - acumulado.begin());
+            if (k >= cantidad) k = cantidad - 1;
+            const char* palabra = palabras[k];
+            datos.insert(datos.end(), palabra, palabra + strlen(palabra));
+            datos.push_back(w + 1 < cuantas ? ' ' : '\n');
+        }
+    }
+    datos.resize(size);
+}
+
+//distribucion geometrica: el byte k aparece con probabilidad 2^-(k+1), genera codigos muy largos
+//y obliga a limitar las longitudes
+void generateSkewed(vector<unsigned char>& datos, size_t size, Rng& rng) {
+    datos.resize(size);
+    unsigned long long bits = 0;
+    int disponibles = 0;
+    for (size_t i = 0; i < size; ++i) {
+        //cantidad de ceros seguidos en bits aleatorios
+        unsigned char k = 0;
+        while (true) {
+            if (disponibles == 0) {
+                bits = rng.next();
+                disponibles = 64;
+            }
+            bool uno = (bits & 1) != 0;
+            bits >>= 1;
+            disponibles--;
+            if (uno || k == 255) break;
+            k++;
+        }
+        datos[i] = k;
+    }
+}
+
+//un unico byte repetido
+void generateSingle(vector<unsigned char>& datos, size_t size) {
+    datos.assign(size, (unsigned char)'A');
+}
+
+//imagen de disco casi vacia: paginas de 4 KiB en cero con una de cada 32 ocupada por texto o datos aleatorios
+void generateSparse(vector<unsigned char>& datos, size_t size, Rng& rng) {
+    const size_t PAGINA = 4096;
+    datos.assign(size, 0);
+    vector<unsigned char> pagina;
+    for (size_t p = 0; p < size; p += PAGINA) {
+        if (rng.below(32) != 0) continue;
+        size_t tamano = min(PAGINA, size - p);
+        if (rng.below(2) == 0) {
+            generateRandom(pagina, tamano, rng);
+        }
+        else {
+            generateText(pagina, tamano, rng);
+        }
+        memcpy(&datos[p], &pagina[0], tamano);
+    }
+}
+
+//reinicia el pico de memoria residente para que cada caso informe el suyo y no el mayor de los anteriores
+//solo linux lo permite (clear_refs); en otros sistemas devuelve false y el pico es el acumulado del proceso
+bool resetPeakRss() {
+#if defined(__linux__)
+    ofstream refs("/proc/self/clear_refs");
+    refs << "5";
+    refs.close();
+    return !refs.fail();
+#else
+    return false;
+#endif
+}
+
+//pico de memoria residente en KiB desde el ultimo resetPeakRss (o desde el inicio del proceso),
+//0 si el sistema no lo informa
+unsigned long long peakRssKb() {
+#if defined(__linux__)
+    //ru_maxrss no se reinicia con clear_refs, VmHWM si
+    ifstream estado("/proc/self/status");
+    string linea;
+    while (getline(estado, linea)) {
+        if (linea.compare(0, 6, "VmHWM:") == 0) return strtoull(linea.c_str() + 6, NULL, 10);
+    }
+#endif
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS contadores;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &contadores, sizeof(contadores))) {
+        return (unsigned long long)contadores.PeakWorkingSetSize / 1024;
+    }
+    return 0;
+#elif defined(__linux__) || defined(__APPLE__)
+    struct rusage uso;
+    if (getrusage(RUSAGE_SELF, &uso) != 0) return 0;
+#if defined(__APPLE__)
+    //en macOS ru_maxrss esta en bytes
+    return (unsigned long long)uso.ru_maxrss / 1024;
+#else
+    return (unsigned long long)uso.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+double secondsSince(chrono::steady_clock::time_point inicio) {
+    return chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+}
+
+//mediciones de un caso, cada tiempo es el de la repeticion mas rapida
+struct BenchResult {
+    string nombre;
+    unsigned long long original;
+    unsigned long long comprimido;
+    double segundosCompresion;
+    double segundosEscritura;
+    double segundosDescompresion;
+    CodecStats etapasCompresion;
+    CodecStats etapasDescompresion;
+    unsigned long long picoRssKb;
+    //true si picoRssKb es solo de este caso, false si es el acumulado del proceso
+    bool picoPorCaso;
+    bool ok;
+};
+
+//MB/s con MB = 10^6 bytes; todas las velocidades cuentan bytes originales para poder compararlas entre etapas
+double megabytesPerSecond(unsigned long long bytes, double segundos) {
+    return segundos > 0 ? (double)bytes / segundos / 1e6 : 0;
+}
+
+//comprime y descomprime datos repeticiones veces, escribiendo el .cpm en archivoTemporal para medir la escritura
+BenchResult runCase(const string& nombre,
+    const vector<unsigned char>& datos,
+    const CompressOptions& opciones,
+    int repeticiones,
+    const string& archivoTemporal) {
+    BenchResult r;
+    r.nombre = nombre;
+    r.original = datos.size();
+    r.segundosCompresion = r.segundosEscritura = r.segundosDescompresion = 0;
+    r.ok = true;
+    //el pico incluye los datos del caso, que ya estan en memoria, y todo lo que reserva el codec
+    r.picoPorCaso = resetPeakRss();
+
+    //los contextos y buffers se reutilizan entre repeticiones, como en un servicio que comprime muchos mensajes
+    EncoderContext encoder(opciones);
+    DecoderContext decoder;
+    vector<unsigned char> comprimido;
+    vector<unsigned char> recuperado;
+    CodecStats etapas;
+    encoder.setStats(&etapas);
+    decoder.setStats(&etapas);
+
+    for (int i = 0; i < repeticiones && r.ok; ++i) {
+        etapas.reset();
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        r.ok = encoder.compress(ByteSpan(datos), comprimido);
+        double t = secondsSince(inicio);
+        if (i == 0 || t < r.segundosCompresion) {
+            r.segundosCompresion = t;
+            r.etapasCompresion = etapas;
+        }
+    }
+    r.comprimido = comprimido.size();
+
+    for (int i = 0; i < repeticiones && r.ok; ++i) {
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        {
+            ofstream out(archivoTemporal.c_str(), ios::binary | ios::trunc);
+            if (!comprimido.empty()) out.write((const char*)&comprimido[0], (streamsize)comprimido.size());
+            out.close();
+            if (!out) {
+                cerr << "No se pudo escribir el archivo temporal: " << archivoTemporal << "\n";
+                r.ok = false;
+            }
+        }
+        double t = secondsSince(inicio);
+        if (i == 0 || t < r.segundosEscritura) r.segundosEscritura = t;
+    }
+    remove(archivoTemporal.c_str());
+    r.etapasCompresion.nanos[ETAPA_ESCRITURA] = (unsigned long long)(r.segundosEscritura * 1e9);
+
+    for (int i = 0; i < repeticiones && r.ok; ++i) {
+        etapas.reset();
+        chrono::steady_clock::time_point inicio = chrono::steady_clock::now();
+        r.ok = decoder.decompress(ByteSpan(comprimido), recuperado);
+        double t = secondsSince(inicio);
+        if (i == 0 || t < r.segundosDescompresion) {
+            r.segundosDescompresion = t;
+            r.etapasDescompresion = etapas;
+        }
+    }
+    //una diferencia con el original es una regresion, no solo una medicion mala
+    r.ok = r.ok && recuperado == datos;
+    r.picoRssKb = peakRssKb();
+    return r;
+}
+
+//etapas con tiempo medido, en una sola linea
+void printStages(const CodecStats& etapas) {
+    for (int e = 0; e < CPM_ETAPAS; ++e) {
+        if (etapas.nanos[e] > 0) cout << " " << CPM_NOMBRES_ETAPAS[e] << "=" << etapas.nanos[e] / 1e6;
+    }
+}
+
+void printResult(const BenchResult& r) {
+    cout << r.nombre << "\n";
+    cout << "  tamano original   : " << r.original << " bytes\n";
+    cout << "  tamano comprimido : " << r.comprimido << " bytes (" << (r.original ? 100.0 * r.comprimido / r.original : 0) << "%)\n";
+    cout << "  compresion        : " << megabytesPerSecond(r.original, r.segundosCompresion) << " MB/s\n";
+    cout << "  escritura .cpm    : " << megabytesPerSecond(r.original, r.segundosEscritura) << " MB/s\n";
+    cout << "  descompresion     : " << megabytesPerSecond(r.original, r.segundosDescompresion) << " MB/s\n";
+    cout << "  pico de memoria   : " << r.picoRssKb << " KiB" << (r.picoPorCaso ? "" : " (acumulado del proceso)") << "\n";
+    cout << "  etapas al comprimir (ms)    :";
+    printStages(r.etapasCompresion);
+    cout << "\n";
+    cout << "  etapas al descomprimir (ms) :";
+    printStages(r.etapasDescompresion);
+    cout << "\n";
+    if (!r.ok) cout << "  ERROR: los datos recuperados no coinciden con el original\n";
+}
+
+void appendStagesJson(ostream& out, const CodecStats& etapas) {
+    out << "{";
+    for (int e = 0; e < CPM_ETAPAS; ++e) {
+        out << (e ? ", " : "") << "\"" << CPM_NOMBRES_ETAPAS[e] << "\": " << etapas.nanos[e] / 1e6;
+    }
+    out << "}";
+}
+
+//nombres de archivo con comillas o barras invertidas se escapan para que el json siga siendo valido
+string jsonString(const string& texto) {
+    string out = "\"";
+    for (size_t i = 0; i < texto.size(); ++i) {
+        unsigned char c = (unsigned char)texto[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += (char)c;
+        }
+        else if (c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out += escape;
+        }
+        else {
+            out += (char)c;
+        }
+    }
+    return out + "\"";
+}
+
+void writeJson(ostream& out, const CompressOptions& opciones, int repeticiones, unsigned long long semilla, const vector<BenchResult>& resultados) {
+    out << "{\n";
+    out << "  \"opciones\": {\"maxLongitud\": " << opciones.maxLongitud << ", \"flujos\": " << opciones.flujos
+        << ", \"nivelLz\": " << opciones.nivelLz << ", \"ventanaLz\": " << opciones.ventanaLz
+        << ", \"umbralTabla\": " << opciones.umbralTabla
+        << ", \"checksum\": " << (opciones.checksum ? "true" : "false") << ", \"repeticiones\": " << repeticiones
+        << ", \"semilla\": " << semilla << "},\n";
+    out << "  \"resultados\": [\n";
+    for (size_t i = 0; i < resultados.size(); ++i) {
+        const BenchResult& r = resultados[i];
+        out << "    {\"nombre\": " << jsonString(r.nombre)
+            << ", \"bytes\": " << r.original
+            << ", \"comprimido\": " << r.comprimido
+            << ", \"proporcion\": " << (r.original ? (double)r.comprimido / r.original : 0)
+            << ", \"compresion_mb_s\": " << megabytesPerSecond(r.original, r.segundosCompresion)
+            << ", \"escritura_mb_s\": " << megabytesPerSecond(r.original, r.segundosEscritura)
+            << ", \"descompresion_mb_s\": " << megabytesPerSecond(r.original, r.segundosDescompresion)
+            << ", \"pico_rss_kb\": " << r.picoRssKb
+            << ", \"pico_rss_por_caso\": " << (r.picoPorCaso ? "true" : "false")
+            << ", \"ok\": " << (r.ok ? "true" : "false") << ",\n";
+        out << "     \"etapas_compresion_ms\": ";
+        appendStagesJson(out, r.etapasCompresion);
+        out << ",\n";
+        out << "     \"etapas_descompresion_ms\": ";
+        appendStagesJson(out, r.etapasDescompresion);
+        out << "}" << (i + 1 < resultados.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n";
+    out << "}\n";
+}
+
+void printUsage(const char* programa) {
+    cerr << "Uso: " << programa << " [opciones] [archivo...]\n";
+    cerr << "Sin archivos se usa el corpus generado: aleatorio, texto, sesgado, un_simbolo y disperso.\n";
+    cerr << "  -s MB          tamano de cada caso del corpus en MiB (por defecto 32; disperso usa el cuadruple)\n";
+    cerr << "  -r N           repeticiones de cada medicion, se informa la mas rapida (por defecto 3)\n";
+    cerr << "  --semilla N    semilla del corpus (por defecto 1)\n";
+    cerr << "  --corpus       mide tambien el corpus generado cuando se pasan archivos\n";
+    cerr << "  -L N, -S N, -Z N, -W N, -A N   opciones de compresion, como en el programa principal\n";
+    cerr << "  --sin-crc      comprime sin crc por bloque\n";
+    cerr << "  --json archivo guarda los resultados en json (\"-\" los escribe en la salida estandar)\n";
+    cerr << "  --tmp ruta     archivo temporal para medir la escritura (por defecto cpmbench.tmp)\n";
+}
+
+int main(int argc, char* argv[]) {
+    CompressOptions opciones;
+    size_t megas = 32;
+    int repeticiones = 3;
+    unsigned long long semilla = 1;
+    bool conCorpus = false;
+    string json;
+    string temporal = "cpmbench.tmp";
+    vector<string> archivos;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        bool conValor = i + 1 < argc;
+        if (arg == "-s" && conValor) {
+            megas = (size_t)strtoull(argv[++i], NULL, 10);
+        }
+        else if (arg == "-r" && conValor) {
+            repeticiones = atoi(argv[++i]);
+        }
+        else if (arg == "--semilla" && conValor) {
+            semilla = strtoull(argv[++i], NULL, 10);
+        }
+        else if (arg == "-L" && conValor) {
+            opciones.maxLongitud = atoi(argv[++i]);
+        }
+        else if (arg == "-S" && conValor) {
+            opciones.flujos = atoi(argv[++i]);
+        }
+        else if (arg == "-Z" && conValor) {
+            opciones.nivelLz = atoi(argv[++i]);
+        }
+        else if (arg == "-W" && conValor) {
+            opciones.ventanaLz = atoi(argv[++i]);
+        }
+        else if (arg == "-A" && conValor) {
+            opciones.umbralTabla = atoi(argv[++i]);
+        }
+        else if (arg == "--sin-crc") {
+            opciones.checksum = false;
+        }
+        else if (arg == "--corpus") {
+            conCorpus = true;
+        }
+        else if (arg == "--json" && conValor) {
+            json = argv[++i];
+        }
+        else if (arg == "--tmp" && conValor) {
+            temporal = argv[++i];
+        }
+        else if (!arg.empty() && arg[0] != '-') {
+            archivos.push_back(arg);
+        }
+        else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (megas == 0 || repeticiones < 1 ||
+        opciones.maxLongitud < MIN_MAX_CODE_LENGTH || opciones.maxLongitud > BIT_WRITER_MAX_BITS ||
+        (opciones.flujos != 1 && opciones.flujos != CPM_FLUJOS) ||
+        opciones.nivelLz < 0 || opciones.nivelLz > LZ_NIVEL_MAXIMO ||
+        opciones.ventanaLz < LZ_VENTANA_MIN || opciones.ventanaLz > LZ_VENTANA_MAX ||
+        opciones.umbralTabla < 0 || opciones.umbralTabla > 100 || (opciones.umbralTabla > 0 && opciones.nivelLz > 0)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    //con el json en la salida estandar el informe de texto va a la salida de errores
+    bool jsonEstandar = json == "-";
+    streambuf* original = NULL;
+    if (jsonEstandar) original = cout.rdbuf(cerr.rdbuf());
+
+    vector<BenchResult> resultados;
+    size_t tamano = megas << 20;
+    vector<unsigned char> datos;
+
+    //cada caso se genera justo antes de medirlo, asi solo uno ocupa memoria a la vez
+    if (archivos.empty() || conCorpus) {
+        for (int caso = 0; caso < 5; ++caso) {
+            Rng rng(semilla + (unsigned long long)caso);
+            string nombre;
+            switch (caso) {
+            case 0: nombre = "aleatorio"; generateRandom(datos, tamano, rng); break;
+            case 1: nombre = "texto"; generateText(datos, tamano, rng); break;
+            case 2: nombre = "sesgado"; generateSkewed(datos, tamano, rng); break;
+            case 3: nombre = "un_simbolo"; generateSingle(datos, tamano); break;
+            default: nombre = "disperso"; generateSparse(datos, tamano * 4, rng); break;
+            }
+            resultados.push_back(runCase(nombre, datos, opciones, repeticiones, temporal));
+            printResult(resultados.back());
+        }
+    }
+
+    for (size_t i = 0; i < archivos.size(); ++i) {
+        ifstream in(archivos[i].c_str(), ios::binary);
+        if (!in) {
+            cerr << "No se pudo abrir el archivo de entrada: " << archivos[i] << "\n";
+            return 1;
+        }
+        datos.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        resultados.push_back(runCase(archivos[i], datos, opciones, repeticiones, temporal));
+        printResult(resultados.back());
+    }
+
+    if (jsonEstandar) cout.rdbuf(original);
+    if (!json.empty()) {
+        if (jsonEstandar) {
+            writeJson(cout, opciones, repeticiones, semilla, resultados);
+        }
+        else {
+            ofstream out(json.c_str(), ios::trunc);
+            writeJson(out, opciones, repeticiones, semilla, resultados);
+            if (!out) {
+                cerr << "No se pudo escribir el archivo json: " << json << "\n";
+                return 1;
+            }
+        }
+    }
+
+    for (size_t i = 0; i < resultados.size(); ++i) {
+        if (!resultados[i].ok) return 1;
+    }
+    return 0;
+}
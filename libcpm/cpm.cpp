@@ -0,0 +1,1947 @@
+//libcpm: construccion de codigos, codificacion y decodificacion de bloques y la interfaz en memoria
+#include "cpm.h"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+//en procesadores x86 se habilitan los caminos vectoriales, elegidos en tiempo de ejecucion
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CPM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+//gcc y clang solo aceptan intrinsecas avx2 en funciones marcadas para ese conjunto de instrucciones
+#if defined(CPM_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CPM_TARGET_AVX2 __attribute__((target("avx2")))
+#define CPM_TARGET_SSE42 __attribute__((target("sse4.2")))
+#else
+#define CPM_TARGET_AVX2
+#define CPM_TARGET_SSE42
+#endif
+
+using namespace std;
+
+//crea el arbol de huffman sin cola de prioridad ni memoria dinamica (metodo de las dos colas)
+//las hojas se ordenan por frecuencia y los nodos internos se generan con frecuencia creciente,
+//asi los dos nodos mas livianos siempre estan al frente de alguna de las dos secuencias
+void buildHuffmanTree(const unsigned long long freqs[256], HuffmanArbol& arbol) {
+    arbol.cantidad = 0;
+    arbol.raiz = -1;
+
+    for (int i = 0; i < 256; ++i) {
+        //cada simbolo con frecuencia positiva se convierte en un nodo hoja, insertado en orden
+        if (freqs[i] == 0) continue;
+        int j = arbol.cantidad++;
+        while (j > 0 && arbol.nodos[j - 1].frecuencia > freqs[i]) {
+            arbol.nodos[j] = arbol.nodos[j - 1];
+            j--;
+        }
+        HuffmanNodo hoja = { freqs[i], i, -1, -1 };
+        arbol.nodos[j] = hoja;
+    }
+
+    int hojas = arbol.cantidad;
+    if (hojas == 0) return;
+
+    //caso especial con un simbolo
+    if (hojas == 1) {
+        //se crea un nodo padre artificial para conservar la logica de recorridos binarios
+        HuffmanNodo padre = { arbol.nodos[0].frecuencia, -1, 0, -1 };
+        arbol.nodos[arbol.cantidad] = padre;
+        arbol.raiz = arbol.cantidad++;
+        return;
+    }
+
+    //frente de la secuencia de hojas y de la secuencia de nodos internos
+    int siguienteHoja = 0;
+    int siguienteInterno = hojas;
+    while (arbol.cantidad < 2 * hojas - 1) {
+        //extrae dos nodos con menor frecuencia para combinarlos en un nuevo padre
+        int hijos[2];
+        for (int k = 0; k < 2; ++k) {
+            bool hayHoja = siguienteHoja < hojas;
+            bool hayInterno = siguienteInterno < arbol.cantidad;
+            if (hayHoja && (!hayInterno || arbol.nodos[siguienteHoja].frecuencia <= arbol.nodos[siguienteInterno].frecuencia)) {
+                hijos[k] = siguienteHoja++;
+            }
+            else {
+                hijos[k] = siguienteInterno++;
+            }
+        }
+
+        //el nuevo padre guarda la suma de frecuencias para mantener la codificacion optima
+        HuffmanNodo padre = { arbol.nodos[hijos[0]].frecuencia + arbol.nodos[hijos[1]].frecuencia, -1, hijos[0], hijos[1] };
+        arbol.nodos[arbol.cantidad++] = padre;
+    }
+    arbol.raiz = arbol.cantidad - 1;
+}
+
+//obtiene la longitud del codigo de cada byte, que es la profundidad de su hoja
+//los bits concretos no se toman del arbol: se asignan despues en forma canonica
+//como los hijos siempre estan antes que su padre, basta recorrer el arreglo desde la raiz hacia atras
+void buildCodeLengths(const HuffmanArbol& arbol, unsigned char lengths[256]) {
+    for (int i = 0; i < 256; ++i) lengths[i] = 0;
+    if (arbol.raiz < 0) return;
+
+    int profundidad[HUFFMAN_MAX_NODOS];
+    profundidad[arbol.raiz] = 0;
+    for (int i = arbol.raiz; i >= 0; --i) {
+        const HuffmanNodo& nodo = arbol.nodos[i];
+        if (nodo.byteGuardado >= 0) {
+            //la raiz sola (un unico simbolo) igual necesita un bit
+            lengths[nodo.byteGuardado] = (unsigned char)(profundidad[i] > 0 ? profundidad[i] : 1);
+            continue;
+        }
+        if (nodo.izquierda >= 0) profundidad[nodo.izquierda] = profundidad[i] + 1;
+        if (nodo.derecha >= 0) profundidad[nodo.derecha] = profundidad[i] + 1;
+    }
+}
+
+//intercambia el orden de bytes para leer y escribir palabras big endian en equipos little endian
+inline unsigned long long byteSwap64(unsigned long long v) {
+#if defined(_MSC_VER)
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+//asigna codigos canonicos a partir de las longitudes: los codigos de igual longitud son
+//consecutivos en orden de simbolo y cada longitud continua donde termino la anterior,
+//asi el decodificador reconstruye exactamente los mismos bits conociendo solo las longitudes
+//falla si las longitudes no forman un codigo prefijo valido
+bool buildCanonicalCodes(const unsigned char lengths[256], CodeTable& tabla) {
+    unsigned int cantidadPorLongitud[BIT_WRITER_MAX_BITS + 1];
+    for (int l = 0; l <= BIT_WRITER_MAX_BITS; ++l) cantidadPorLongitud[l] = 0;
+
+    tabla.maxLongitud = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (lengths[i] > BIT_WRITER_MAX_BITS) return false;
+        cantidadPorLongitud[lengths[i]]++;
+        if (lengths[i] > tabla.maxLongitud) tabla.maxLongitud = lengths[i];
+    }
+    cantidadPorLongitud[0] = 0;
+
+    //primer codigo de cada longitud
+    unsigned long long siguiente[BIT_WRITER_MAX_BITS + 1];
+    unsigned long long code = 0;
+    siguiente[0] = 0;
+    for (int l = 1; l <= BIT_WRITER_MAX_BITS; ++l) {
+        code = (code + cantidadPorLongitud[l - 1]) << 1;
+        siguiente[l] = code;
+    }
+
+    for (int i = 0; i < 256; ++i) {
+        int len = lengths[i];
+        tabla.longitud[i] = (unsigned char)len;
+        tabla.bits[i] = 0;
+        if (len == 0) continue;
+        tabla.bits[i] = siguiente[len]++;
+        //si el codigo no entra en len bits, las longitudes piden mas codigos de los que existen
+        if (tabla.bits[i] >> len) return false;
+    }
+    return true;
+}
+
+//recalcula las longitudes para que ninguna supere maxLongitud usando package-merge
+//el resultado es el codigo prefijo optimo entre todos los que respetan el limite
+//
+//cada simbolo empieza como una moneda con peso igual a su frecuencia en el nivel mas profundo;
+//en cada nivel hacia la raiz se empaquetan de a pares los elementos del nivel anterior y se mezclan,
+//ordenados por peso, con las monedas originales. De la lista del nivel 1 se toman los 2n-2 elementos
+//mas livianos, y la longitud de cada simbolo es la cantidad de veces que su moneda queda elegida
+//contando tambien las monedas que contienen los paquetes elegidos
+//trabaja sobre arreglos fijos, sin reservar memoria
+void limitCodeLengths(const unsigned long long freqs[256], int maxLongitud, unsigned char lengths[256]) {
+    //monedas ordenadas de menor a mayor frecuencia, con su simbolo asociado
+    unsigned long long pesoHoja[256];
+    int simbolo[256];
+    int n = 0;
+    for (int i = 0; i < 256; ++i) {
+        lengths[i] = 0;
+        if (freqs[i] == 0) continue;
+        //insercion ordenada, estable para que los empates respeten el orden de los simbolos
+        int j = n++;
+        while (j > 0 && pesoHoja[j - 1] > freqs[i]) {
+            pesoHoja[j] = pesoHoja[j - 1];
+            simbolo[j] = simbolo[j - 1];
+            j--;
+        }
+        pesoHoja[j] = freqs[i];
+        simbolo[j] = i;
+    }
+    if (n == 0) return;
+    if (n == 1) {
+        lengths[simbolo[0]] = 1;
+        return;
+    }
+
+    //por nivel se guarda si cada elemento de la lista es una moneda o un paquete, para el recorrido final
+    //solo hacen falta los pesos del nivel actual y del anterior
+    static const int MAX_LISTA = 2 * 256;
+    unsigned char esHoja[BIT_WRITER_MAX_BITS + 1][MAX_LISTA];
+    int tamLista[BIT_WRITER_MAX_BITS + 1];
+    unsigned long long peso[2][MAX_LISTA];
+    int actual = 0;
+
+    for (int i = 0; i < n; ++i) {
+        peso[actual][i] = pesoHoja[i];
+        esHoja[maxLongitud][i] = 1;
+    }
+    tamLista[maxLongitud] = n;
+
+    for (int nivel = maxLongitud - 1; nivel >= 1; --nivel) {
+        int anterior = actual;
+        actual ^= 1;
+        int paquetes = tamLista[nivel + 1] / 2;
+        int i = 0;
+        int j = 0;
+        int k = 0;
+        while (i < n || j < paquetes) {
+            unsigned long long pesoPaquete = j < paquetes ? peso[anterior][2 * j] + peso[anterior][2 * j + 1] : 0;
+            if (j >= paquetes || (i < n && pesoHoja[i] <= pesoPaquete)) {
+                peso[actual][k] = pesoHoja[i++];
+                esHoja[nivel][k++] = 1;
+            }
+            else {
+                peso[actual][k] = pesoPaquete;
+                esHoja[nivel][k++] = 0;
+                j++;
+            }
+        }
+        tamLista[nivel] = k;
+    }
+
+    //se recorren los niveles desde la raiz: las monedas elegidas de cada nivel son siempre las mas livianas,
+    //y los paquetes elegidos piden el doble de elementos del nivel siguiente
+    int elegidos = 2 * n - 2;
+    for (int nivel = 1; nivel <= maxLongitud && elegidos > 0; ++nivel) {
+        int hojas = 0;
+        for (int i = 0; i < elegidos; ++i) {
+            hojas += esHoja[nivel][i];
+        }
+        for (int i = 0; i < hojas; ++i) {
+            lengths[simbolo[i]]++;
+        }
+        elegidos = 2 * (elegidos - hojas);
+    }
+}
+
+//convierte los codigos de texto del formato v1 a enteros
+//falla si algun codigo supera 64 bits, algo que solo ocurre con arboles extremadamente desbalanceados
+bool buildCodeTable(const vector<string>& codes, CodeTable& tabla) {
+    tabla.maxLongitud = 0;
+    for (int i = 0; i < 256; ++i) {
+        tabla.bits[i] = 0;
+        tabla.longitud[i] = 0;
+        const string& code = codes[i];
+        if (code.empty()) continue;
+
+        int len = (int)code.size();
+        if (len > 64) return false;
+        for (int b = 0; b < len; ++b) {
+            tabla.bits[i] = (tabla.bits[i] << 1) | (code[b] == '1' ? 1u : 0u);
+        }
+        tabla.longitud[i] = (unsigned char)len;
+        if (len > tabla.maxLongitud) tabla.maxLongitud = len;
+    }
+    return true;
+}
+
+//escritor de bits que acumula codigos en una palabra de 64 bits y emite bytes completos
+//el destino debe tener 8 bytes extra al final porque cada llamada guarda la palabra entera
+struct BitWriter {
+    unsigned char* out;
+    //siguiente byte libre del destino
+    size_t pos;
+    //bits pendientes alineados a la izquierda
+    unsigned long long buffer;
+    //cantidad de bits pendientes, siempre menor a 8 entre llamadas
+    int count;
+
+    BitWriter(unsigned char* destino) : out(destino), pos(0), buffer(0), count(0) {
+    }
+
+    //agrega len bits (1 a BIT_WRITER_MAX_BITS) sin bifurcaciones
+    //se guarda la palabra completa y solo se avanza por los bytes terminados
+    void put(unsigned long long code, int len) {
+        buffer |= code << (64 - count - len);
+        count += len;
+        unsigned long long palabra = byteSwap64(buffer);
+        memcpy(out + pos, &palabra, 8);
+        int bytes = count >> 3;
+        pos += bytes;
+        buffer <<= bytes * 8;
+        count &= 7;
+    }
+
+    //escribe el ultimo byte incompleto completado con ceros y devuelve el total escrito
+    size_t finish() {
+        if (count > 0) {
+            out[pos++] = (unsigned char)(buffer >> 56);
+            buffer = 0;
+            count = 0;
+        }
+        return pos;
+    }
+};
+
+//empaqueta los codigos de data en destino con el escritor de 64 bits y devuelve los bytes escritos
+//destino necesita lugar para el resultado mas 8 bytes que pisa la ultima escritura de palabra
+size_t packSymbols(const unsigned char* data, size_t size, const CodeTable& tabla, unsigned char* destino) {
+    BitWriter writer(destino);
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char b = data[i];
+        writer.put(tabla.bits[b], tabla.longitud[b]);
+    }
+    return writer.finish();
+}
+
+//empaqueta los codigos de cada byte de entrada directamente al final del buffer de salida
+//el tamano exacto se conoce de antemano sumando frecuencia por longitud de cada simbolo
+void encodeSymbols(const unsigned char* data,
+    size_t size,
+    const unsigned long long freqs[256],
+    const CodeTable& tabla,
+    vector<unsigned char>& out,
+    int& paddedBits) {
+    unsigned long long totalBits = 0;
+    for (int i = 0; i < 256; ++i) {
+        totalBits += freqs[i] * (unsigned long long)tabla.longitud[i];
+    }
+    paddedBits = (int)((8 - (totalBits % 8)) % 8);
+
+    size_t inicio = out.size();
+    size_t totalBytes = (size_t)((totalBits + 7) / 8);
+    //espacio extra para la ultima palabra que guarda el escritor
+    out.resize(inicio + totalBytes + 8, 0);
+    out.resize(inicio + packSymbols(data, size, tabla, &out[inicio]));
+}
+
+//como encodeSymbols pero sin frecuencias: reserva el peor caso (todos con el codigo mas largo) y recorta
+//al final; sirve cuando la tabla viene de una muestra y no se recorrio el bloque completo
+void encodeSymbolsBounded(const unsigned char* data, size_t size, const CodeTable& tabla, vector<unsigned char>& out, int& paddedBits) {
+    size_t inicio = out.size();
+    out.resize(inicio + (size * (size_t)tabla.maxLongitud + 7) / 8 + 8);
+    BitWriter writer(&out[inicio]);
+    for (size_t i = 0; i < size; ++i) {
+        unsigned char b = data[i];
+        writer.put(tabla.bits[b], tabla.longitud[b]);
+    }
+    paddedBits = (8 - writer.count) & 7;
+    out.resize(inicio + writer.finish());
+}
+
+//divide los datos en CPM_FLUJOS tramos consecutivos y empaqueta cada uno en su propio flujo de bits
+//los tres primeros tramos tienen (size + 3) / 4 bytes y el ultimo el resto; antes de los flujos
+//se guarda el tamano en bytes de los tres primeros para que el decodificador ubique cada uno
+void encodeFourStreams(const unsigned char* data, size_t size, const CodeTable& tabla, vector<unsigned char>& out) {
+    size_t segmento = (size + CPM_FLUJOS - 1) / CPM_FLUJOS;
+    size_t posTamanos = out.size();
+    out.resize(posTamanos + 4 * (CPM_FLUJOS - 1), 0);
+
+    for (int k = 0; k < CPM_FLUJOS; ++k) {
+        size_t desde = (size_t)k * segmento < size ? (size_t)k * segmento : size;
+        size_t cantidad = size - desde < segmento ? size - desde : segmento;
+
+        //cota superior del flujo: todos los simbolos con el codigo mas largo, mas la palabra extra del escritor
+        size_t base = out.size();
+        out.resize(base + (cantidad * (size_t)tabla.maxLongitud + 7) / 8 + 8);
+        size_t escritos = packSymbols(data + desde, cantidad, tabla, &out[base]);
+        out.resize(base + escritos);
+
+        if (k < CPM_FLUJOS - 1) {
+            for (int i = 0; i < 4; ++i) {
+                out[posTamanos + 4 * k + i] = (unsigned char)(escritos >> (8 * i));
+            }
+        }
+    }
+}
+
+//lector de bits que trabaja directo sobre los bytes empaquetados
+//mantiene hasta 64 bits alineados a la izquierda para poder mirar el siguiente codigo sin recorrerlo
+struct BitReader {
+    const unsigned char* data;
+    size_t size;
+    //siguiente byte que todavia no entro al acumulador
+    size_t pos;
+    //bits pendientes, el bit mas significativo es el proximo a consumir
+    unsigned long long buffer;
+    //cantidad de bits validos dentro del acumulador
+    int count;
+
+    BitReader(const unsigned char* d, size_t n) : data(d), size(n), pos(0), buffer(0), count(0) {
+    }
+
+    //completa el acumulador para dejar al menos 56 bits disponibles mientras haya datos
+    void refill() {
+        if (pos + 8 <= size) {
+            //carga rapida de una palabra completa, los bits sobrantes se vuelven a cargar en la siguiente vuelta
+            unsigned long long palabra;
+            memcpy(&palabra, data + pos, 8);
+            buffer |= byteSwap64(palabra) >> count;
+            int bytes = (63 - count) >> 3;
+            pos += bytes;
+            count += bytes * 8;
+            return;
+        }
+        //cerca del final se avanza byte a byte para no leer fuera del buffer
+        while (count <= 56 && pos < size) {
+            buffer |= ((unsigned long long)data[pos++]) << (56 - count);
+            count += 8;
+        }
+    }
+
+    unsigned long long peek(int bits) const {
+        return buffer >> (64 - bits);
+    }
+
+    void consume(int bits) {
+        buffer <<= bits;
+        count -= bits;
+    }
+
+    //bits ya consumidos desde el inicio del flujo, count queda negativo si se consumio mas de lo cargado
+    unsigned long long consumed() const {
+        return (unsigned long long)((long long)pos * 8 - count);
+    }
+};
+
+//arma el arbol plano y la tabla de consulta a partir de los codigos numericos
+bool buildDecoder(const CodeTable& codes, HuffmanDecoder& dec) {
+    dec.nodos.clear();
+    DecodeNodo raiz = { { -1, -1 }, -1 };
+    dec.nodos.push_back(raiz);
+
+    for (int i = 0; i < 256; ++i) {
+        int len = codes.longitud[i];
+        if (len == 0) continue;
+
+        //se inserta el codigo recorriendo el arbol desde su bit mas significativo y creando los nodos que falten
+        int nodo = 0;
+        for (int b = len - 1; b >= 0; --b) {
+            if (dec.nodos[nodo].simbolo >= 0) return false;
+            int bit = (int)((codes.bits[i] >> b) & 1);
+            if (dec.nodos[nodo].hijos[bit] < 0) {
+                DecodeNodo nuevo = { { -1, -1 }, -1 };
+                dec.nodos.push_back(nuevo);
+                dec.nodos[nodo].hijos[bit] = (int)dec.nodos.size() - 1;
+            }
+            nodo = dec.nodos[nodo].hijos[bit];
+        }
+
+        //un codigo que es prefijo de otro no se puede decodificar sin ambiguedad
+        if (dec.nodos[nodo].hijos[0] >= 0 || dec.nodos[nodo].hijos[1] >= 0 || dec.nodos[nodo].simbolo >= 0) return false;
+        dec.nodos[nodo].simbolo = i;
+    }
+
+    //cada indice de la tabla representa los proximos bits del flujo
+    //se recorre el arbol con esos bits hasta llegar a una hoja o agotar la tabla
+    dec.tabla.assign((size_t)1 << DECODE_TABLE_BITS, DecodeEntrada());
+    for (size_t indice = 0; indice < dec.tabla.size(); ++indice) {
+        DecodeEntrada entrada = { DECODE_INVALIDO, 0 };
+        int nodo = 0;
+        for (int b = 0; b < DECODE_TABLE_BITS; ++b) {
+            int bit = (int)((indice >> (DECODE_TABLE_BITS - 1 - b)) & 1);
+            nodo = dec.nodos[nodo].hijos[bit];
+            if (nodo < 0) break;
+            if (dec.nodos[nodo].simbolo >= 0) {
+                entrada.valor = (unsigned short)dec.nodos[nodo].simbolo;
+                entrada.longitud = (unsigned char)(b + 1);
+                break;
+            }
+        }
+        if (nodo >= 0 && entrada.longitud == 0) {
+            //el codigo sigue despues de la tabla, se guarda el nodo para continuar bit a bit
+            entrada.valor = (unsigned short)nodo;
+        }
+        dec.tabla[indice] = entrada;
+    }
+    return true;
+}
+
+//resuelve un codigo mas largo que la tabla recorriendo el arbol bit a bit
+//devuelve -1 si el flujo no corresponde a ningun codigo
+inline int decodeSlow(const HuffmanDecoder& dec, BitReader& reader, unsigned short nodoInicial) {
+    if (nodoInicial == DECODE_INVALIDO) return -1;
+    reader.consume(DECODE_TABLE_BITS);
+    int nodo = nodoInicial;
+    while (dec.nodos[nodo].simbolo < 0) {
+        if (reader.count < 1) {
+            reader.refill();
+            if (reader.count < 1) return -1;
+        }
+        int bit = (int)(reader.buffer >> 63);
+        reader.consume(1);
+        nodo = dec.nodos[nodo].hijos[bit];
+        if (nodo < 0) return -1;
+    }
+    return dec.nodos[nodo].simbolo;
+}
+
+//decodifica hasta 4 simbolos con una sola recarga del lector
+//solo se usa cuando quedan al menos 8 bytes sin cargar, caso en que los bits leidos nunca caen en el relleno:
+//tras la recarga hay al menos 56 bits, suficientes para 4 codigos resueltos por la tabla
+//un codigo mas largo que la tabla corta la vuelta porque el camino lento recarga por su cuenta
+inline bool decodeRound(const HuffmanDecoder& dec, const DecodeEntrada* tabla, BitReader& reader, unsigned char*& destino) {
+    reader.refill();
+    for (int k = 0; k < 4; ++k) {
+        const DecodeEntrada& entrada = tabla[(size_t)reader.peek(DECODE_TABLE_BITS)];
+        if (entrada.longitud == 0) {
+            int simbolo = decodeSlow(dec, reader, entrada.valor);
+            if (simbolo < 0) return false;
+            *destino++ = (unsigned char)simbolo;
+            return true;
+        }
+        *destino++ = (unsigned char)entrada.valor;
+        reader.consume(entrada.longitud);
+    }
+    return true;
+}
+
+//continua decodificando con un lector ya iniciado hasta maxSymbols bytes, sin pasar de totalBits bits
+//devuelve cuantos bytes se recuperaron, menos de lo pedido si los datos se agotan o son invalidos
+size_t decodeWithReader(const HuffmanDecoder& dec,
+    BitReader& reader,
+    unsigned long long totalBits,
+    unsigned char* out,
+    size_t maxSymbols) {
+    //se trabaja sobre una copia local: las escrituras en out (unsigned char) podrian apuntar a
+    //cualquier objeto, y con el lector fuera de la pila el compilador lo recargaria en cada simbolo
+    BitReader local = reader;
+    const DecodeEntrada* tabla = &dec.tabla[0];
+    unsigned char* destino = out;
+    unsigned char* fin = out + maxSymbols;
+
+    //camino rapido mientras queden datos de sobra
+    while (fin - destino >= 4 && local.pos + 8 <= local.size) {
+        if (!decodeRound(dec, tabla, local, destino)) {
+            reader = local;
+            return (size_t)(destino - out);
+        }
+    }
+    reader = local;
+    size_t producidos = (size_t)(destino - out);
+
+    //camino final: se valida cada simbolo contra la cantidad real de bits
+    while (producidos < maxSymbols) {
+        reader.refill();
+        if (reader.consumed() >= totalBits) break;
+        const DecodeEntrada& entrada = dec.tabla[(size_t)reader.peek(DECODE_TABLE_BITS)];
+        int simbolo;
+        if (entrada.longitud > 0) {
+            simbolo = entrada.valor;
+            reader.consume(entrada.longitud);
+        }
+        else {
+            simbolo = decodeSlow(dec, reader, entrada.valor);
+            if (simbolo < 0) break;
+        }
+        if (reader.consumed() > totalBits) break;
+        out[producidos++] = (unsigned char)simbolo;
+    }
+    return producidos;
+}
+
+//decodifica hasta maxSymbols bytes leyendo totalBits bits validos del flujo empaquetado
+size_t decodeSymbols(const HuffmanDecoder& dec,
+    const unsigned char* data,
+    size_t size,
+    unsigned long long totalBits,
+    unsigned char* out,
+    size_t maxSymbols) {
+    BitReader reader(data, size);
+    return decodeWithReader(dec, reader, totalBits, out, maxSymbols);
+}
+
+//decodifica los cuatro flujos de un bloque entrelazado avanzando en cada uno por turno:
+//como los flujos no dependen entre si, el procesador puede resolver las cuatro consultas a la vez
+//en lugar de esperar la longitud de cada codigo antes de buscar el siguiente
+bool decodeFourStreams(const HuffmanDecoder& dec,
+    const unsigned char* flujos[CPM_FLUJOS],
+    const size_t tamanos[CPM_FLUJOS],
+    unsigned char* out,
+    size_t rawSize) {
+    size_t segmento = (rawSize + CPM_FLUJOS - 1) / CPM_FLUJOS;
+    size_t cuenta[CPM_FLUJOS];
+    unsigned char* destino[CPM_FLUJOS];
+    for (int k = 0; k < CPM_FLUJOS; ++k) {
+        size_t desde = (size_t)k * segmento < rawSize ? (size_t)k * segmento : rawSize;
+        cuenta[k] = rawSize - desde < segmento ? rawSize - desde : segmento;
+        destino[k] = out + desde;
+    }
+
+    BitReader r0(flujos[0], tamanos[0]);
+    BitReader r1(flujos[1], tamanos[1]);
+    BitReader r2(flujos[2], tamanos[2]);
+    BitReader r3(flujos[3], tamanos[3]);
+    unsigned char* d0 = destino[0];
+    unsigned char* d1 = destino[1];
+    unsigned char* d2 = destino[2];
+    unsigned char* d3 = destino[3];
+    unsigned char* f0 = d0 + cuenta[0];
+    unsigned char* f1 = d1 + cuenta[1];
+    unsigned char* f2 = d2 + cuenta[2];
+    unsigned char* f3 = d3 + cuenta[3];
+    const DecodeEntrada* tabla = &dec.tabla[0];
+
+    //mientras a ningun flujo le falten datos se avanza en los cuatro a la vez
+    while (f0 - d0 >= 4 && f1 - d1 >= 4 && f2 - d2 >= 4 && f3 - d3 >= 4 &&
+        r0.pos + 8 <= r0.size && r1.pos + 8 <= r1.size && r2.pos + 8 <= r2.size && r3.pos + 8 <= r3.size) {
+        bool ok = decodeRound(dec, tabla, r0, d0);
+        ok &= decodeRound(dec, tabla, r1, d1);
+        ok &= decodeRound(dec, tabla, r2, d2);
+        ok &= decodeRound(dec, tabla, r3, d3);
+        if (!ok) return false;
+    }
+
+    //cada flujo termina por separado con las verificaciones de fin de datos
+    BitReader lectores[CPM_FLUJOS] = { r0, r1, r2, r3 };
+    unsigned char* actual[CPM_FLUJOS] = { d0, d1, d2, d3 };
+    for (int k = 0; k < CPM_FLUJOS; ++k) {
+        size_t faltan = cuenta[k] - (size_t)(actual[k] - destino[k]);
+        unsigned long long bits = (unsigned long long)tamanos[k] * 8;
+        if (decodeWithReader(dec, lectores[k], bits, actual[k], faltan) != faltan) return false;
+    }
+    return true;
+}
+
+//lee un entero de 4 bytes desde el buffer
+unsigned int readUInt(const unsigned char* data, size_t size, size_t& offset) {
+    if (offset + 4 > size) return 0;
+    //se reconstruye el entero en formato little endian aplicando corrimientos de 8 bits
+    unsigned int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        //cada byte se desplaza segun su peso y se combina con or para reconstruir el entero
+        value |= ((unsigned int)data[offset + i]) << (8 * i);
+    }
+    offset += 4;
+    return value;
+}
+
+unsigned int readUInt(const vector<unsigned char>& data, size_t& offset) {
+    return readUInt(data.empty() ? NULL : &data[0], data.size(), offset);
+}
+
+//lee un entero de 8 bytes usando desplazamientos
+unsigned long long readULL(const vector<unsigned char>& data, size_t& offset) {
+    if (offset + 8 > data.size()) return 0;
+    //la logica replica el proceso anterior pero ampliando a 64 bits para manejar valores grandes
+    unsigned long long value = 0;
+    for (int i = 0; i < 8; ++i) {
+        //se aprovechan corrimientos de 8 bits para ubicar cada byte en su posicion correcta
+        value |= ((unsigned long long)data[offset + i]) << (8 * i);
+    }
+    offset += 8;
+    return value;
+}
+
+//agrega un entero de 4 bytes en formato little endian, inverso de readUInt
+void appendUInt(vector<unsigned char>& data, unsigned int value) {
+    for (int i = 0; i < 4; ++i) {
+        data.push_back((unsigned char)(value >> (8 * i)));
+    }
+}
+
+//agrega un entero de 8 bytes en formato little endian, inverso de readULL
+void appendULL(vector<unsigned char>& data, unsigned long long value) {
+    for (int i = 0; i < 8; ++i) {
+        data.push_back((unsigned char)(value >> (8 * i)));
+    }
+}
+
+//serializa solo las longitudes de los codigos canonicos, eligiendo el formato mas corto
+void appendCodeLengths(vector<unsigned char>& out, const unsigned char lengths[256]) {
+    int usados = 0;
+    int maxLongitud = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (lengths[i] == 0) continue;
+        usados++;
+        if (lengths[i] > maxLongitud) maxLongitud = lengths[i];
+    }
+
+    size_t tamanoLista = 1 + 2 * (size_t)usados;
+    size_t tamanoFijo = maxLongitud <= 15 ? 128 : 256;
+    if (usados < 256 && tamanoLista < tamanoFijo) {
+        out.push_back(TABLA_LISTA);
+        out.push_back((unsigned char)usados);
+        for (int i = 0; i < 256; ++i) {
+            if (lengths[i] == 0) continue;
+            out.push_back((unsigned char)i);
+            out.push_back(lengths[i]);
+        }
+    }
+    else if (maxLongitud <= 15) {
+        out.push_back(TABLA_NIBBLES);
+        for (int i = 0; i < 256; i += 2) {
+            //el simbolo par ocupa los 4 bits altos y el impar los 4 bajos
+            out.push_back((unsigned char)((lengths[i] << 4) | lengths[i + 1]));
+        }
+    }
+    else {
+        out.push_back(TABLA_BYTES);
+        out.insert(out.end(), lengths, lengths + 256);
+    }
+}
+
+//lee una tabla escrita por appendCodeLengths
+bool readCodeLengths(const unsigned char* data, size_t size, size_t& offset, unsigned char lengths[256]) {
+    for (int i = 0; i < 256; ++i) lengths[i] = 0;
+    if (offset + 1 > size) return false;
+    unsigned char formato = data[offset++];
+
+    if (formato == TABLA_LISTA) {
+        if (offset + 1 > size) return false;
+        size_t usados = data[offset++];
+        if (offset + 2 * usados > size) return false;
+        for (size_t i = 0; i < usados; ++i) {
+            lengths[data[offset]] = data[offset + 1];
+            offset += 2;
+        }
+        return true;
+    }
+    if (formato == TABLA_NIBBLES) {
+        if (offset + 128 > size) return false;
+        for (int i = 0; i < 256; i += 2) {
+            lengths[i] = (unsigned char)(data[offset] >> 4);
+            lengths[i + 1] = (unsigned char)(data[offset] & 0x0F);
+            offset++;
+        }
+        return true;
+    }
+    if (formato == TABLA_BYTES) {
+        if (offset + 256 > size) return false;
+        memcpy(lengths, &data[offset], 256);
+        offset += 256;
+        return true;
+    }
+    return false;
+}
+
+unsigned char fileFlags(const CompressOptions& opciones) {
+    return (unsigned char)((opciones.checksum ? CPM_FLAG_CRC32C : 0) | (opciones.umbralTabla > 0 ? CPM_FLAG_TABLA_VIGENTE : 0) |
+        (opciones.diccionario ? CPM_FLAG_DICCIONARIO : 0));
+}
+
+//arma el header v2 en memoria para escribirlo de una vez
+void appendFileHeader(vector<unsigned char>& out, const string& originalName, unsigned int blockSize, unsigned char flags, unsigned int diccionario) {
+    out.insert(out.end(), CPM_MAGIC, CPM_MAGIC + 4);
+    out.push_back(CPM_VERSION);
+    out.push_back(flags);
+    //bytes reservados en cero para futuras extensiones
+    out.push_back(0);
+    out.push_back(0);
+    appendUInt(out, blockSize);
+    appendUInt(out, (unsigned int)originalName.size());
+    out.insert(out.end(), originalName.begin(), originalName.end());
+    if (flags & CPM_FLAG_DICCIONARIO) appendUInt(out, diccionario);
+}
+
+//agrega el indice de bloques y el pie que permite ubicarlo desde el final del archivo
+void appendBlockIndex(vector<unsigned char>& out, const vector<BlockIndexEntry>& indice, unsigned long long indexOffset) {
+    for (size_t i = 0; i < indice.size(); ++i) {
+        appendULL(out, indice[i].offset);
+        appendUInt(out, indice[i].compressedSize);
+        appendUInt(out, indice[i].rawSize);
+    }
+    appendULL(out, indexOffset);
+    appendUInt(out, (unsigned int)indice.size());
+    out.insert(out.end(), CPM_INDEX_MAGIC, CPM_INDEX_MAGIC + 4);
+}
+
+//tablas parciales del histograma: bytes vecinos se cuentan en tablas distintas para que
+//incrementos seguidos del mismo byte (datos repetitivos) no esperen uno al otro
+const int HISTOGRAM_TABLAS = 4;
+//los contadores parciales son de 32 bits, se vuelcan a la tabla final antes de que puedan desbordarse
+const size_t HISTOGRAM_TRAMO = (size_t)1 << 30;
+
+typedef void (*HistogramKernel)(const unsigned char* data, size_t size, unsigned int tablas[HISTOGRAM_TABLAS][256]);
+
+//cuenta de a 8 bytes con una lectura de 64 bits, repartiendo los bytes entre las tablas parciales
+void histogramScalar(const unsigned char* data, size_t size, unsigned int tablas[HISTOGRAM_TABLAS][256]) {
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long palabra;
+        memcpy(&palabra, data + i, 8);
+        tablas[0][palabra & 0xFF]++;
+        tablas[1][(palabra >> 8) & 0xFF]++;
+        tablas[2][(palabra >> 16) & 0xFF]++;
+        tablas[3][(palabra >> 24) & 0xFF]++;
+        tablas[0][(palabra >> 32) & 0xFF]++;
+        tablas[1][(palabra >> 40) & 0xFF]++;
+        tablas[2][(palabra >> 48) & 0xFF]++;
+        tablas[3][palabra >> 56]++;
+    }
+    for (; i < size; ++i) {
+        tablas[0][data[i]]++;
+    }
+}
+
+#if defined(CPM_X86)
+//lee 32 bytes por vuelta con avx2; si los 32 son el mismo byte (ceros, relleno, corridas en logs)
+//se suman de una vez, y si no se reparten entre las tablas parciales como en la version escalar
+CPM_TARGET_AVX2 void histogramAvx2(const unsigned char* data, size_t size, unsigned int tablas[HISTOGRAM_TABLAS][256]) {
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        __m256i primero = _mm256_set1_epi8((char)data[i]);
+        if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, primero)) == -1) {
+            tablas[0][data[i]] += 32;
+            continue;
+        }
+
+        unsigned long long palabras[4];
+        _mm256_storeu_si256((__m256i*)palabras, v);
+        for (int k = 0; k < 4; ++k) {
+            unsigned long long palabra = palabras[k];
+            tablas[0][palabra & 0xFF]++;
+            tablas[1][(palabra >> 8) & 0xFF]++;
+            tablas[2][(palabra >> 16) & 0xFF]++;
+            tablas[3][(palabra >> 24) & 0xFF]++;
+            tablas[0][(palabra >> 32) & 0xFF]++;
+            tablas[1][(palabra >> 40) & 0xFF]++;
+            tablas[2][(palabra >> 48) & 0xFF]++;
+            tablas[3][palabra >> 56]++;
+        }
+    }
+    histogramScalar(data + i, size - i, tablas);
+}
+
+//consulta cpuid: avx2 requiere soporte del procesador y que el sistema guarde los registros ymm
+bool cpuHasAvx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+//elige una sola vez el mejor kernel disponible en el procesador actual
+HistogramKernel selectHistogramKernel() {
+#if defined(CPM_X86)
+    if (cpuHasAvx2()) return histogramAvx2;
+#endif
+    return histogramScalar;
+}
+
+//cuenta cuantas veces aparece cada byte en el rango indicado, se usa por bloque
+void countFrequencies(const unsigned char* data, size_t size, unsigned long long freqs[256]) {
+    static const HistogramKernel kernel = selectHistogramKernel();
+
+    //se inicializa la tabla con ceros antes de sumar apariciones
+    for (int i = 0; i < 256; ++i) freqs[i] = 0;
+
+    unsigned int tablas[HISTOGRAM_TABLAS][256];
+    for (size_t inicio = 0; inicio < size; inicio += HISTOGRAM_TRAMO) {
+        memset(tablas, 0, sizeof(tablas));
+        size_t tramo = size - inicio < HISTOGRAM_TRAMO ? size - inicio : HISTOGRAM_TRAMO;
+        kernel(data + inicio, tramo, tablas);
+        //se suman las tablas parciales en la tabla final
+        for (int t = 0; t < HISTOGRAM_TABLAS; ++t) {
+            for (int b = 0; b < 256; ++b) {
+                freqs[b] += tablas[t][b];
+            }
+        }
+    }
+}
+
+//polinomio crc32c en forma reflejada, el mismo que calcula la instruccion crc32 de sse4.2
+const unsigned int CRC32C_POLINOMIO = 0x82F63B78u;
+
+typedef unsigned int (*Crc32cKernel)(const unsigned char* data, size_t size, unsigned int crc);
+
+//tablas del metodo slicing-by-8: tabla[k][b] es el crc de b seguido de k bytes en cero,
+//asi cada vuelta procesa 8 bytes con 8 consultas independientes
+struct Crc32cTablas {
+    unsigned int tabla[8][256];
+
+    Crc32cTablas() {
+        for (unsigned int b = 0; b < 256; ++b) {
+            unsigned int crc = b;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (CRC32C_POLINOMIO & (0u - (crc & 1)));
+            }
+            tabla[0][b] = crc;
+        }
+        for (unsigned int b = 0; b < 256; ++b) {
+            for (int k = 1; k < 8; ++k) {
+                tabla[k][b] = (tabla[k - 1][b] >> 8) ^ tabla[0][tabla[k - 1][b] & 0xFF];
+            }
+        }
+    }
+};
+
+//version portable, trabaja sobre el crc ya invertido
+unsigned int crc32cScalar(const unsigned char* data, size_t size, unsigned int crc) {
+    static const Crc32cTablas tablas;
+    const unsigned int (*t)[256] = tablas.tabla;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        unsigned int bajo;
+        unsigned int alto;
+        memcpy(&bajo, data + i, 4);
+        memcpy(&alto, data + i + 4, 4);
+        bajo ^= crc;
+        crc = t[7][bajo & 0xFF] ^ t[6][(bajo >> 8) & 0xFF] ^ t[5][(bajo >> 16) & 0xFF] ^ t[4][bajo >> 24] ^
+              t[3][alto & 0xFF] ^ t[2][(alto >> 8) & 0xFF] ^ t[1][(alto >> 16) & 0xFF] ^ t[0][alto >> 24];
+    }
+    for (; i < size; ++i) {
+        crc = (crc >> 8) ^ t[0][(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+#if defined(CPM_X86)
+//la instruccion crc32 procesa 8 bytes (4 en 32 bits) por ciclo de latencia
+CPM_TARGET_SSE42 unsigned int crc32cSse42(const unsigned char* data, size_t size, unsigned int crc) {
+    size_t i = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+    unsigned long long crc64 = crc;
+    for (; i + 8 <= size; i += 8) {
+        unsigned long long palabra;
+        memcpy(&palabra, data + i, 8);
+        crc64 = _mm_crc32_u64(crc64, palabra);
+    }
+    crc = (unsigned int)crc64;
+#else
+    for (; i + 4 <= size; i += 4) {
+        unsigned int palabra;
+        memcpy(&palabra, data + i, 4);
+        crc = _mm_crc32_u32(crc, palabra);
+    }
+#endif
+    for (; i < size; ++i) {
+        crc = _mm_crc32_u8(crc, data[i]);
+    }
+    return crc;
+}
+
+bool cpuHasSse42() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 20)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2") != 0;
+#endif
+}
+#endif
+
+Crc32cKernel selectCrc32cKernel() {
+#if defined(CPM_X86)
+    if (cpuHasSse42()) return crc32cSse42;
+#endif
+    return crc32cScalar;
+}
+
+unsigned int crc32c(const unsigned char* data, size_t size, unsigned int crc) {
+    static const Crc32cKernel kernel = selectCrc32cKernel();
+    return ~kernel(data, size, ~crc);
+}
+
+//cota inferior, en bytes, de la parte codificada de un bloque huffman: modo, la tabla de longitudes
+//mas chica posible y la entropia de orden 0 de los datos
+//ningun codigo prefijo baja de la entropia, por eso si la cota no mejora el bloque sin comprimir
+//no hace falta construir el arbol
+unsigned long long estimateHuffmanBytes(const unsigned long long freqs[256], size_t size) {
+    double bits = 0;
+    unsigned long long usados = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (freqs[i] == 0) continue;
+        bits += (double)freqs[i] * log2((double)size / (double)freqs[i]);
+        usados++;
+    }
+    unsigned long long tabla = min(2 + 2 * usados, 1 + 128ULL);
+    return 1 + tabla + (unsigned long long)(bits / 8);
+}
+
+//longitudes de codigo optimas para freqs sin superar maxLongitud bits
+bool buildLimitedLengths(const unsigned long long freqs[256], int maxLongitud, unsigned char lengths[256]) {
+    HuffmanArbol arbol;
+    buildHuffmanTree(freqs, arbol);
+    if (arbol.raiz < 0) return false;
+
+    //del arbol solo se necesita la profundidad de cada hoja
+    buildCodeLengths(arbol, lengths);
+
+    //solo si el arbol optimo supera el limite se recalculan las longitudes
+    for (int i = 0; i < 256; ++i) {
+        if (lengths[i] > maxLongitud) {
+            limitCodeLengths(freqs, maxLongitud, lengths);
+            break;
+        }
+    }
+    return true;
+}
+
+//bytes que ocuparia la parte codificada de un bloque con una tabla externa: modo, cantidad de flujos,
+//relleno o tamanos de flujo, y los codigos; ~0 si algun byte de los datos no tiene codigo en la tabla
+unsigned long long estimateExternalBytes(const unsigned long long freqs[256], size_t size, const CodeTable& tabla, const CompressOptions& opciones) {
+    unsigned long long totalBits = 0;
+    for (int i = 0; i < 256; ++i) {
+        if (freqs[i] == 0) continue;
+        if (tabla.longitud[i] == 0) return ~0ULL;
+        totalBits += freqs[i] * (unsigned long long)tabla.longitud[i];
+    }
+    bool cuatroFlujos = opciones.flujos == CPM_FLUJOS && size >= FOUR_STREAM_MIN_SIZE;
+    return 2 + (totalBits + 7) / 8 + (cuatroFlujos ? 4 * (CPM_FLUJOS - 1) + CPM_FLUJOS - 1 : 1);
+}
+
+//empaqueta data con tabla en uno o cuatro flujos al final de block
+//con un flujo el relleno del ultimo byte se guarda en block[posRelleno]; freqs puede ser NULL si no se conoce
+void appendHuffmanStreams(const unsigned char* data,
+    size_t size,
+    const unsigned long long freqs[256],
+    const CodeTable& tabla,
+    bool cuatroFlujos,
+    vector<unsigned char>& block,
+    size_t posRelleno,
+    CodecStats* stats) {
+    ScopedTimer timer(stats, ETAPA_CODIFICACION);
+    if (stats) stats->simbolos += size;
+    if (cuatroFlujos) {
+        encodeFourStreams(data, size, tabla, block);
+    }
+    else {
+        int paddedBits = 0;
+        if (freqs) encodeSymbols(data, size, freqs, tabla, block, paddedBits);
+        else encodeSymbolsBounded(data, size, tabla, block, paddedBits);
+        block[posRelleno] = (unsigned char)paddedBits;
+    }
+}
+
+//agrega modo, tabla y flujos huffman de un bloque; devuelve false sin tocar block si el resultado
+//no seria mas chico que guardar el bloque sin comprimir
+bool encodeHuffmanPayload(const unsigned char* data,
+    size_t size,
+    const unsigned long long freqs[256],
+    vector<unsigned char>& block,
+    const CompressOptions& opciones,
+    CodecStats* stats) {
+    unsigned char lengths[256];
+    CodeTable tabla;
+    {
+        ScopedTimer timer(stats, ETAPA_ARBOL);
+        if (estimateHuffmanBytes(freqs, size) >= 1 + (unsigned long long)size) return false;
+        if (!buildLimitedLengths(freqs, opciones.maxLongitud, lengths) || !buildCanonicalCodes(lengths, tabla)) return false;
+    }
+
+    //con las longitudes ya se conoce el tamano del payload, se descarta antes de empaquetar
+    unsigned long long totalBits = 0;
+    for (int i = 0; i < 256; ++i) {
+        totalBits += freqs[i] * (unsigned long long)lengths[i];
+    }
+    bool cuatroFlujos = opciones.flujos == CPM_FLUJOS && size >= FOUR_STREAM_MIN_SIZE;
+    size_t inicio = block.size();
+    block.push_back(cuatroFlujos ? BLOQUE_CUATRO_FLUJOS : BLOQUE_UN_FLUJO);
+    if (!cuatroFlujos) block.push_back(0);
+    appendCodeLengths(block, lengths);
+    //en cuatro flujos se suman los tamanos de flujo y hasta un byte de relleno por flujo
+    unsigned long long estimado = (block.size() - inicio) + (totalBits + 7) / 8 + (cuatroFlujos ? 4 * (CPM_FLUJOS - 1) + CPM_FLUJOS - 1 : 0);
+    if (estimado >= 1 + (unsigned long long)size) {
+        block.resize(inicio);
+        return false;
+    }
+
+    appendHuffmanStreams(data, size, freqs, tabla, cuatroFlujos, block, inicio + 1, stats);
+    return true;
+}
+
+//agrega un bloque huffman codificado con una tabla que no viaja en el bloque
+//quien llama ya comprobo con estimateExternalBytes que la tabla tiene codigo para cada byte de data
+void encodeExternalPayload(const unsigned char* data,
+    size_t size,
+    const unsigned long long freqs[256],
+    const CodeTable& tabla,
+    vector<unsigned char>& block,
+    const CompressOptions& opciones,
+    CodecStats* stats) {
+    bool cuatroFlujos = opciones.flujos == CPM_FLUJOS && size >= FOUR_STREAM_MIN_SIZE;
+    block.push_back(BLOQUE_TABLA_EXTERNA);
+    block.push_back((unsigned char)(cuatroFlujos ? CPM_FLUJOS : 1));
+    size_t posRelleno = block.size();
+    if (!cuatroFlujos) block.push_back(0);
+    appendHuffmanStreams(data, size, freqs, tabla, cuatroFlujos, block, posRelleno, stats);
+}
+
+//codifica un bloque independiente sin lz77 eligiendo el modo mas chico: un unico byte repetido,
+//huffman (con su propia tabla de codigos o con externa, si no es NULL) o los bytes sin comprimir
+//el resultado se agrega al final de block listo para escribirse: tamanos, modo y parte codificada
+//freqs es el histograma de data
+bool encodePlainBlock(const unsigned char* data,
+    size_t size,
+    const unsigned long long freqs[256],
+    vector<unsigned char>& block,
+    const CompressOptions& opciones,
+    const CodeTable* externa,
+    CodecStats* stats) {
+    if (size == 0) return false;
+
+    size_t inicio = block.size();
+    appendUInt(block, (unsigned int)size);
+    //el tamano codificado se completa al final, cuando ya se conoce el largo del payload
+    appendUInt(block, 0);
+
+    if (freqs[data[0]] == size) {
+        //un solo valor: alcanza con guardarlo una vez, sin arbol
+        block.push_back(BLOQUE_REPETIDO);
+        block.push_back(data[0]);
+    }
+    else {
+        unsigned long long externo = externa ? estimateExternalBytes(freqs, size, *externa, opciones) : ~0ULL;
+        bool propia = false;
+        //la entropia acota lo que puede lograr una tabla propia: si la externa ya la alcanza no se construye el arbol
+        if (externo > estimateHuffmanBytes(freqs, size)) {
+            size_t antes = block.size();
+            propia = encodeHuffmanPayload(data, size, freqs, block, opciones, stats);
+            if (propia && block.size() - antes > externo) {
+                block.resize(antes);
+                propia = false;
+            }
+        }
+        if (!propia && externo < 1 + (unsigned long long)size) {
+            encodeExternalPayload(data, size, freqs, *externa, block, opciones, stats);
+        }
+        else if (!propia) {
+            //datos ya comprimidos o aleatorios: se copian tal cual y el bloque nunca crece mas de un byte
+            ScopedTimer timer(stats, ETAPA_CODIFICACION);
+            block.push_back(BLOQUE_SIN_COMPRIMIR);
+            block.insert(block.end(), data, data + size);
+        }
+    }
+
+    unsigned int encodedSize = (unsigned int)(block.size() - inicio - 8);
+    for (int i = 0; i < 4; ++i) {
+        block[inicio + 4 + i] = (unsigned char)(encodedSize >> (8 * i));
+    }
+    return true;
+}
+
+//parametros de busqueda de cada nivel lz77
+struct LzNivel {
+    //candidatos de la cadena de hash que se comparan en cada posicion
+    int profundidad;
+    //una coincidencia de este largo se acepta sin seguir buscando
+    int largoSuficiente;
+    //antes de aceptar una coincidencia se prueba si en la posicion siguiente empieza una mas larga
+    bool perezoso;
+    //se agregan a la cadena tambien las posiciones dentro de cada copia (mas lento, encuentra mas)
+    bool insertarTodo;
+};
+
+const LzNivel LZ_NIVELES[LZ_NIVEL_MAXIMO + 1] = {
+    { 0, 0, false, false },
+    { 1, 16, false, false },
+    { 2, 24, false, false },
+    { 4, 32, false, true },
+    { 8, 32, true, true },
+    { 16, 64, true, true },
+    { 32, 128, true, true },
+    { 64, 256, true, true },
+    { 256, 1024, true, true },
+    { 1024, 4096, true, true }
+};
+
+//bits del hash de 4 bytes que indexa las cadenas
+const int LZ_HASH_BITS = 16;
+
+//por debajo de este tamano no hay espacio para copias que compensen los flujos extra
+const size_t LZ_MIN_SIZE = 64;
+
+inline unsigned int lzHash(const unsigned char* p) {
+    unsigned int v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+//bytes significativos de una distancia: los flujos de los bytes altos son casi todos ceros y
+//comprimen a muy poco, por eso una copia lejana cuesta mas que una cercana del mismo largo
+inline size_t lzDistanceCost(size_t distancia) {
+    return distancia < 256 ? 1 : (distancia < 65536 ? 2 : 3);
+}
+
+//cantidad de bytes iguales desde a y b, sin pasar de maximo; compara de a 8 bytes
+inline size_t lzMatchLength(const unsigned char* a, const unsigned char* b, size_t maximo) {
+    size_t largo = 0;
+    while (largo + 8 <= maximo) {
+        unsigned long long x;
+        unsigned long long y;
+        memcpy(&x, a + largo, 8);
+        memcpy(&y, b + largo, 8);
+        if (x != y) {
+            //en little endian el primer byte distinto es el bit en 1 mas bajo de la diferencia
+            unsigned long long diferencia = x ^ y;
+            int bytes = 0;
+            while ((diferencia & 0xFF) == 0) {
+                diferencia >>= 8;
+                bytes++;
+            }
+            return largo + bytes;
+        }
+        largo += 8;
+    }
+    while (largo < maximo && a[largo] == b[largo]) largo++;
+    return largo;
+}
+
+//agrega un largo a un flujo de largos: menos de 255 ocupa un byte, si no 255 y el resto en 3 bytes
+void appendLzLength(vector<unsigned char>& flujo, size_t valor) {
+    if (valor < 255) {
+        flujo.push_back((unsigned char)valor);
+        return;
+    }
+    valor -= 255;
+    flujo.push_back(255);
+    flujo.push_back((unsigned char)valor);
+    flujo.push_back((unsigned char)(valor >> 8));
+    flujo.push_back((unsigned char)(valor >> 16));
+}
+
+//lee un largo escrito por appendLzLength, devuelve false si el flujo se termina
+inline bool readLzLength(const vector<unsigned char>& flujo, size_t& offset, size_t& valor) {
+    if (offset >= flujo.size()) return false;
+    valor = flujo[offset++];
+    if (valor < 255) return true;
+    if (offset + 3 > flujo.size()) return false;
+    valor = 255 + ((size_t)flujo[offset] | ((size_t)flujo[offset + 1] << 8) | ((size_t)flujo[offset + 2] << 16));
+    offset += 3;
+    return true;
+}
+
+//busca coincidencias con cadenas de hash y reparte las secuencias en los flujos de trabajo
+//devuelve la cantidad de secuencias; los literales que quedan despues de la ultima van al final del flujo 0
+size_t parseLz77(const unsigned char* data, size_t size, const CompressOptions& opciones, BlockEncoder& trabajo) {
+    const LzNivel& nivel = LZ_NIVELES[opciones.nivelLz];
+    size_t ventana = (size_t)1 << opciones.ventanaLz;
+    size_t mascara = ventana - 1;
+    //la distancia se guarda en 3 bytes y nunca llega a la ventana completa
+    size_t maxDistancia = ventana - 1;
+
+    trabajo.cabeza.assign((size_t)1 << LZ_HASH_BITS, -1);
+    //previo no necesita valores iniciales: cada posicion se escribe al insertarla, antes de poder leerse
+    trabajo.previo.resize(ventana);
+    for (int k = 0; k < LZ_FLUJOS; ++k) trabajo.flujos[k].clear();
+    int* cabeza = &trabajo.cabeza[0];
+    int* previo = &trabajo.previo[0];
+
+    size_t secuencias = 0;
+    size_t ancla = 0;
+    size_t pos = 0;
+    while (pos + LZ_MIN_MATCH <= size) {
+        //mejor coincidencia que empieza en p, revisando a lo sumo profundidad candidatos
+        size_t largo = 0;
+        size_t distancia = 0;
+        for (int intento = 0; intento < 2; ++intento) {
+            size_t p = pos + intento;
+            if (p + LZ_MIN_MATCH > size) break;
+            size_t maximo = size - p;
+            size_t mejor = 0;
+            size_t mejorDistancia = 0;
+            int candidato = cabeza[lzHash(data + p)];
+            for (int d = 0; d < nivel.profundidad && candidato >= 0; ++d) {
+                size_t c = (size_t)candidato;
+                if (c >= p || p - c > maxDistancia) break;
+                //solo vale la pena comparar si el candidato puede superar al mejor hasta ahora
+                if (data[c + mejor] == data[p + mejor] || mejor == 0) {
+                    size_t l = lzMatchLength(data + c, data + p, maximo);
+                    //una copia mas lejana tiene que ganar al menos lo que cuesta su distancia extra
+                    if (l > mejor && (mejor == 0 || l + lzDistanceCost(mejorDistancia) > mejor + lzDistanceCost(p - c))) {
+                        mejor = l;
+                        mejorDistancia = p - c;
+                        if (l >= (size_t)nivel.largoSuficiente || l == maximo) break;
+                    }
+                }
+                candidato = previo[c & mascara];
+            }
+
+            if (intento == 0) {
+                largo = mejor;
+                distancia = mejorDistancia;
+                //la posicion actual se agrega a su cadena despues de buscar en ella
+                unsigned int h = lzHash(data + pos);
+                previo[pos & mascara] = cabeza[h];
+                cabeza[h] = (int)pos;
+                //evaluacion perezosa: solo si hay coincidencia y no es ya suficientemente larga
+                if (largo < LZ_MIN_MATCH || !nivel.perezoso || largo >= (size_t)nivel.largoSuficiente) break;
+            }
+            else if (mejor + lzDistanceCost(distancia) > largo + lzDistanceCost(mejorDistancia)) {
+                //conviene emitir un literal y copiar desde la posicion siguiente
+                pos++;
+                largo = mejor;
+                distancia = mejorDistancia;
+                unsigned int h = lzHash(data + pos);
+                previo[pos & mascara] = cabeza[h];
+                cabeza[h] = (int)pos;
+            }
+        }
+
+        if (largo < LZ_MIN_MATCH) {
+            pos++;
+            continue;
+        }
+
+        trabajo.flujos[0].insert(trabajo.flujos[0].end(), data + ancla, data + pos);
+        appendLzLength(trabajo.flujos[1], pos - ancla);
+        appendLzLength(trabajo.flujos[2], largo - LZ_MIN_MATCH);
+        trabajo.flujos[3].push_back((unsigned char)distancia);
+        trabajo.flujos[4].push_back((unsigned char)(distancia >> 8));
+        trabajo.flujos[5].push_back((unsigned char)(distancia >> 16));
+        secuencias++;
+
+        size_t fin = pos + largo;
+        if (nivel.insertarTodo) {
+            for (size_t p = pos + 1; p < fin && p + LZ_MIN_MATCH <= size; ++p) {
+                unsigned int h = lzHash(data + p);
+                previo[p & mascara] = cabeza[h];
+                cabeza[h] = (int)p;
+            }
+        }
+        pos = fin;
+        ancla = fin;
+    }
+    trabajo.flujos[0].insert(trabajo.flujos[0].end(), data + ancla, data + size);
+    return secuencias;
+}
+
+//codifica un bloque con lz77: las secuencias se separan en flujos de bytes y cada flujo se guarda
+//como un sub-bloque sin lz77, con su propio modo y su propia tabla de codigos
+void encodeLzBlock(const unsigned char* data, size_t size, vector<unsigned char>& block, const CompressOptions& opciones, BlockEncoder& trabajo) {
+    size_t secuencias;
+    {
+        ScopedTimer timer(trabajo.stats, ETAPA_LZ77);
+        secuencias = parseLz77(data, size, opciones, trabajo);
+    }
+
+    size_t inicio = block.size();
+    appendUInt(block, (unsigned int)size);
+    appendUInt(block, 0);
+    block.push_back(BLOQUE_LZ77);
+    appendUInt(block, (unsigned int)secuencias);
+    for (int k = 0; k < LZ_FLUJOS; ++k) {
+        const vector<unsigned char>& flujo = trabajo.flujos[k];
+        if (flujo.empty()) {
+            appendUInt(block, 0);
+            appendUInt(block, 0);
+            continue;
+        }
+        unsigned long long freqs[256];
+        {
+            ScopedTimer timer(trabajo.stats, ETAPA_HISTOGRAMA);
+            countFrequencies(&flujo[0], flujo.size(), freqs);
+        }
+        //los flujos lz77 tienen distribuciones propias, nunca usan la tabla externa
+        encodePlainBlock(&flujo[0], flujo.size(), freqs, block, opciones, NULL, trabajo.stats);
+    }
+
+    unsigned int encodedSize = (unsigned int)(block.size() - inicio - 8);
+    for (int i = 0; i < 4; ++i) {
+        block[inicio + 4 + i] = (unsigned char)(encodedSize >> (8 * i));
+    }
+}
+
+//agrega el crc al bloque que empieza en block[inicio] si corresponde y cuenta el bloque en las estadisticas
+void finishBlock(const unsigned char* data, size_t size, vector<unsigned char>& block, size_t inicio, const CompressOptions& opciones, BlockEncoder& trabajo) {
+    if (opciones.checksum) {
+        //el crc va al final de la parte codificada y cuenta en su tamano
+        unsigned int crc;
+        {
+            ScopedTimer timer(trabajo.stats, ETAPA_CRC);
+            crc = crc32c(data, size, 0);
+        }
+        appendUInt(block, crc);
+        unsigned int encodedSize = (unsigned int)(block.size() - inicio - 8);
+        for (int i = 0; i < 4; ++i) {
+            block[inicio + 4 + i] = (unsigned char)(encodedSize >> (8 * i));
+        }
+    }
+
+    if (trabajo.stats) {
+        trabajo.stats->bloques[block[inicio + 8]]++;
+        trabajo.stats->bytesOriginales += size;
+        trabajo.stats->bytesCodificados += block.size() - inicio;
+    }
+}
+
+//codifica un bloque independiente y agrega al final de block su prefijo de tamanos, modo y parte codificada
+//con lz77 activo se prueba la etapa lz77 y se conserva si no queda mas grande que el bloque sin ella
+bool encodeBlock(const unsigned char* data, size_t size, vector<unsigned char>& block, const CompressOptions& opciones, BlockEncoder& trabajo) {
+    if (size == 0) return false;
+    unsigned long long freqs[256];
+    {
+        ScopedTimer timer(trabajo.stats, ETAPA_HISTOGRAMA);
+        countFrequencies(data, size, freqs);
+    }
+
+    size_t inicio = block.size();
+    if (opciones.nivelLz <= 0 || size < LZ_MIN_SIZE || freqs[data[0]] == size) {
+        encodePlainBlock(data, size, freqs, block, opciones, trabajo.tablaExterna, trabajo.stats);
+    }
+    else {
+        encodeLzBlock(data, size, block, opciones, trabajo);
+        size_t conLz = block.size() - inicio;
+        //la entropia es una cota inferior del bloque huffman sin lz77, y sin comprimir ocupa un byte mas que
+        //los datos: si lz77 ya mejora la menor de las dos no hace falta codificar el bloque de las dos formas
+        if (conLz > 8 + min(estimateHuffmanBytes(freqs, size), 1 + (unsigned long long)size)) {
+            //se usa el final de block como espacio de trabajo para la version sin lz77
+            encodePlainBlock(data, size, freqs, block, opciones, trabajo.tablaExterna, trabajo.stats);
+            size_t sinLz = block.size() - inicio - conLz;
+            if (sinLz < conLz) {
+                memmove(&block[inicio], &block[inicio + conLz], sinLz);
+                block.resize(inicio + sinLz);
+            }
+            else {
+                block.resize(inicio + conLz);
+            }
+        }
+    }
+
+    finishBlock(data, size, block, inicio, opciones, trabajo);
+    return true;
+}
+
+//longitudes de una tabla que se usa con datos que no se contaron (una muestra o un diccionario), por eso
+//todos los bytes tienen codigo: cada uno que no aparecio cuenta como medio byte, lo que casi no alarga
+//los codigos de los que si aparecen
+bool buildCompleteLengths(const unsigned long long freqs[256], int maxLongitud, unsigned char lengths[256]) {
+    unsigned long long suavizadas[256];
+    for (int i = 0; i < 256; ++i) suavizadas[i] = 2 * freqs[i] + 1;
+    return buildLimitedLengths(suavizadas, maxLongitud, lengths);
+}
+
+//muestra de un bloque en el modo de una pasada: MUESTRA_TRAMOS tramos de MUESTRA_TRAMO bytes repartidos
+//a lo largo del bloque, unos 16 KiB por bloque de 1 MiB
+const size_t MUESTRA_TRAMO = 512;
+const size_t MUESTRA_TRAMOS = 32;
+
+void planBlock(const unsigned char* data, size_t size, const CompressOptions& opciones, AdaptiveTable& vigente, BlockPlan& plan, CodecStats* stats) {
+    unsigned long long freqs[256];
+    size_t muestra = size;
+    {
+        ScopedTimer timer(stats, ETAPA_HISTOGRAMA);
+        if (size <= MUESTRA_TRAMO * MUESTRA_TRAMOS) {
+            countFrequencies(data, size, freqs);
+        }
+        else {
+            for (int i = 0; i < 256; ++i) freqs[i] = 0;
+            size_t paso = (size - MUESTRA_TRAMO) / (MUESTRA_TRAMOS - 1);
+            unsigned long long parcial[256];
+            for (size_t t = 0; t < MUESTRA_TRAMOS; ++t) {
+                countFrequencies(data + t * paso, MUESTRA_TRAMO, parcial);
+                for (int i = 0; i < 256; ++i) freqs[i] += parcial[i];
+            }
+            muestra = MUESTRA_TRAMO * MUESTRA_TRAMOS;
+        }
+    }
+
+    //si la muestra tiene un solo valor se comprueba el bloque completo, que corta en la primera diferencia
+    int distintos = 0;
+    for (int i = 0; i < 256; ++i) distintos += freqs[i] > 0;
+    if (distintos == 1 && memcmp(data, data + 1, size - 1) == 0) {
+        plan.tipo = PLAN_REPETIDO;
+        return;
+    }
+
+    ScopedTimer timer(stats, ETAPA_ARBOL);
+    unsigned char lengths[256];
+    buildCompleteLengths(freqs, opciones.maxLongitud, lengths);
+
+    //bits que ocupa la muestra con la tabla nueva y con la vigente
+    unsigned long long bitsNueva = 0;
+    unsigned long long bitsVigente = 0;
+    for (int i = 0; i < 256; ++i) {
+        bitsNueva += freqs[i] * lengths[i];
+        if (vigente.valida) bitsVigente += freqs[i] * vigente.lengths[i];
+    }
+
+    //la tabla vigente se reutiliza mientras la muestra no empeore mas de umbralTabla por ciento;
+    //el bloque no guarda tabla y se evita armar los codigos
+    double escala = (double)size / (double)muestra / 8;
+    if (vigente.valida && bitsVigente * 100 <= bitsNueva * (100 + (unsigned long long)opciones.umbralTabla)) {
+        plan.tipo = bitsVigente * escala < (double)size ? PLAN_TABLA_VIGENTE : PLAN_SIN_COMPRIMIR;
+        plan.tabla = vigente;
+        return;
+    }
+    //ni con una tabla nueva achicaria: se guarda sin comprimir y la tabla vigente sigue igual
+    if (bitsNueva * escala + 128 >= (double)size) {
+        plan.tipo = PLAN_SIN_COMPRIMIR;
+        return;
+    }
+
+    for (int i = 0; i < 256; ++i) vigente.lengths[i] = lengths[i];
+    buildCanonicalCodes(vigente.lengths, vigente.codigos);
+    vigente.valida = true;
+    plan.tipo = PLAN_TABLA_NUEVA;
+    plan.tabla = vigente;
+}
+
+bool encodePlannedBlock(const unsigned char* data,
+    size_t size,
+    const BlockPlan& plan,
+    vector<unsigned char>& block,
+    const CompressOptions& opciones,
+    BlockEncoder& trabajo) {
+    if (size == 0) return false;
+    size_t inicio = block.size();
+    appendUInt(block, (unsigned int)size);
+    appendUInt(block, 0);
+
+    bool sinComprimir = plan.tipo == PLAN_SIN_COMPRIMIR;
+    if (plan.tipo == PLAN_TABLA_VIGENTE || plan.tipo == PLAN_TABLA_NUEVA) {
+        bool nueva = plan.tipo == PLAN_TABLA_NUEVA;
+        bool cuatroFlujos = opciones.flujos == CPM_FLUJOS && size >= FOUR_STREAM_MIN_SIZE;
+        block.push_back(nueva ? BLOQUE_TABLA_NUEVA : BLOQUE_TABLA_EXTERNA);
+        if (nueva) appendCodeLengths(block, plan.tabla.lengths);
+        size_t posFlujos = block.size();
+        block.push_back((unsigned char)(cuatroFlujos ? CPM_FLUJOS : 1));
+        size_t posRelleno = block.size();
+        if (!cuatroFlujos) block.push_back(0);
+        appendHuffmanStreams(data, size, NULL, plan.tabla.codigos, cuatroFlujos, block, posRelleno, trabajo.stats);
+
+        //la muestra pudo no representar al bloque: si los codigos no lo achicaron se guardan los bytes tal cual
+        //(un bloque de tabla nueva conserva su tabla, porque los bloques siguientes la usan)
+        if (block.size() - posFlujos > 1 + size) {
+            if (nueva) {
+                ScopedTimer timer(trabajo.stats, ETAPA_CODIFICACION);
+                block.resize(posFlujos);
+                block.push_back(0);
+                block.insert(block.end(), data, data + size);
+            }
+            else {
+                block.resize(inicio + 8);
+                sinComprimir = true;
+            }
+        }
+    }
+    if (plan.tipo == PLAN_REPETIDO) {
+        block.push_back(BLOQUE_REPETIDO);
+        block.push_back(data[0]);
+    }
+    else if (sinComprimir) {
+        ScopedTimer timer(trabajo.stats, ETAPA_CODIFICACION);
+        block.push_back(BLOQUE_SIN_COMPRIMIR);
+        block.insert(block.end(), data, data + size);
+    }
+
+    unsigned int encodedSize = (unsigned int)(block.size() - inicio - 8);
+    for (int i = 0; i < 4; ++i) {
+        block[inicio + 4 + i] = (unsigned char)(encodedSize >> (8 * i));
+    }
+    finishBlock(data, size, block, inicio, opciones, trabajo);
+    return true;
+}
+
+//decodifica los flujos huffman de un bloque desde offset hasta el final de encoded con una tabla ya armada
+//con un flujo paddedBits es el relleno del ultimo byte; con cuatro, antes de los flujos van sus tamanos
+bool decodeHuffmanStreams(const unsigned char* encoded,
+    size_t encodedSize,
+    size_t offset,
+    bool cuatroFlujos,
+    int paddedBits,
+    size_t rawSize,
+    unsigned char* out,
+    const HuffmanDecoder& tabla,
+    CodecStats* stats) {
+    ScopedTimer timer(stats, ETAPA_DECODIFICACION);
+    if (stats) stats->simbolos += rawSize;
+    if (cuatroFlujos) {
+        if (offset + 4 * (CPM_FLUJOS - 1) > encodedSize) return false;
+        size_t tamanos[CPM_FLUJOS];
+        size_t usados = 0;
+        for (int k = 0; k < CPM_FLUJOS - 1; ++k) {
+            tamanos[k] = readUInt(encoded, encodedSize, offset);
+            usados += tamanos[k];
+        }
+        if (usados > encodedSize - offset) return false;
+        tamanos[CPM_FLUJOS - 1] = encodedSize - offset - usados;
+
+        //los flujos estan uno detras del otro, vacios apuntan a NULL
+        const unsigned char* flujos[CPM_FLUJOS];
+        for (int k = 0; k < CPM_FLUJOS; ++k) {
+            flujos[k] = tamanos[k] > 0 ? &encoded[offset] : NULL;
+            offset += tamanos[k];
+        }
+        return decodeFourStreams(tabla, flujos, tamanos, out, rawSize);
+    }
+
+    size_t payloadSize = encodedSize - offset;
+    unsigned long long totalBits = (unsigned long long)payloadSize * 8;
+    if ((unsigned long long)paddedBits > totalBits) return false;
+    totalBits -= (unsigned long long)paddedBits;
+
+    const unsigned char* payload = payloadSize > 0 ? &encoded[offset] : NULL;
+    size_t producidos = decodeSymbols(tabla, payload, payloadSize, totalBits, out, rawSize);
+    return producidos == rawSize;
+}
+
+//decodifica lo que sigue a la tabla en los modos 5 y 6: flujos(1) y los flujos codificados con tabla
+//sinComprimir acepta flujos 0, los bytes originales tal cual (solo en el modo 6, que define la tabla igual)
+bool decodeExternalStreams(const unsigned char* encoded,
+    size_t encodedSize,
+    size_t offset,
+    bool sinComprimir,
+    size_t rawSize,
+    unsigned char* out,
+    const HuffmanDecoder& tabla,
+    CodecStats* stats) {
+    if (offset + 1 > encodedSize) return false;
+    unsigned char flujos = encoded[offset++];
+    if (flujos == 0 && sinComprimir) {
+        if (encodedSize - offset != rawSize) return false;
+        ScopedTimer timer(stats, ETAPA_DECODIFICACION);
+        memcpy(out, encoded + offset, rawSize);
+        return true;
+    }
+    if (flujos != 1 && flujos != CPM_FLUJOS) return false;
+
+    int paddedBits = 0;
+    if (flujos == 1) {
+        if (offset + 1 > encodedSize) return false;
+        paddedBits = encoded[offset++];
+    }
+    return decodeHuffmanStreams(encoded, encodedSize, offset, flujos == CPM_FLUJOS, paddedBits, rawSize, out, tabla, stats);
+}
+
+//decodifica la parte codificada de un bloque (modo, tabla y flujos) sobre out
+//out debe tener espacio para rawSize bytes, falla si el bloque no alcanza a reconstruirlos
+//encoded puede apuntar directo a un archivo proyectado en memoria
+//decoder se reutiliza entre bloques para no reservar de nuevo su arbol y su tabla
+//externa decodifica los bloques con tabla externa, que sin ella se rechazan
+//no acepta bloques lz77 ni de tabla nueva, que se resuelven en decodeBlock
+bool decodePlainBlock(const unsigned char* encoded,
+    size_t encodedSize,
+    size_t rawSize,
+    unsigned char* out,
+    HuffmanDecoder& decoder,
+    const HuffmanDecoder* externa,
+    CodecStats* stats) {
+    if (encodedSize == 0) return false;
+    size_t offset = 0;
+    unsigned char modo = encoded[offset++];
+    if (modo == BLOQUE_SIN_COMPRIMIR) {
+        if (encodedSize - offset != rawSize) return false;
+        ScopedTimer timer(stats, ETAPA_DECODIFICACION);
+        memcpy(out, encoded + offset, rawSize);
+        return true;
+    }
+    if (modo == BLOQUE_REPETIDO) {
+        if (encodedSize - offset != 1) return false;
+        ScopedTimer timer(stats, ETAPA_DECODIFICACION);
+        memset(out, encoded[offset], rawSize);
+        return true;
+    }
+    if (modo == BLOQUE_TABLA_EXTERNA) {
+        //la tabla ya esta armada, el bloque solo indica cuantos flujos usa
+        return externa && decodeExternalStreams(encoded, encodedSize, offset, false, rawSize, out, *externa, stats);
+    }
+    if (modo != BLOQUE_UN_FLUJO && modo != BLOQUE_CUATRO_FLUJOS) return false;
+
+    int paddedBits = 0;
+    if (modo == BLOQUE_UN_FLUJO) {
+        if (offset + 1 > encodedSize) return false;
+        paddedBits = encoded[offset++];
+    }
+
+    {
+        ScopedTimer timer(stats, ETAPA_TABLAS);
+        unsigned char lengths[256];
+        if (!readCodeLengths(encoded, encodedSize, offset, lengths)) return false;
+
+        CodeTable codes;
+        if (!buildCanonicalCodes(lengths, codes) || !buildDecoder(codes, decoder)) return false;
+    }
+    return decodeHuffmanStreams(encoded, encodedSize, offset, modo == BLOQUE_CUATRO_FLUJOS, paddedBits, rawSize, out, decoder, stats);
+}
+
+//arma la tabla vigente desde la parte codificada de un bloque con tabla nueva y la deja como tabla externa
+//de trabajo; offset queda despues de las longitudes
+bool readNewTable(const unsigned char* encoded, size_t encodedSize, size_t& offset, BlockDecoder& trabajo) {
+    ScopedTimer timer(trabajo.stats, ETAPA_TABLAS);
+    //si la tabla no se puede armar los bloques siguientes tampoco deben usar la anterior
+    trabajo.tablaExterna = NULL;
+    offset = 1;
+    unsigned char lengths[256];
+    if (encodedSize == 0 || encoded[0] != BLOQUE_TABLA_NUEVA || !readCodeLengths(encoded, encodedSize, offset, lengths)) return false;
+    CodeTable codes;
+    if (!buildCanonicalCodes(lengths, codes) || !buildDecoder(codes, trabajo.vigente)) return false;
+    trabajo.tablaExterna = &trabajo.vigente;
+    return true;
+}
+
+bool loadBlockTable(const unsigned char* encoded, size_t encodedSize, BlockDecoder& trabajo) {
+    size_t offset;
+    return readNewTable(encoded, encodedSize, offset, trabajo);
+}
+
+//reconstruye un bloque lz77 a partir de sus flujos ya decodificados, validando cada copia
+bool rebuildLz77(const vector<unsigned char> flujos[LZ_FLUJOS], size_t secuencias, unsigned char* out, size_t rawSize) {
+    const vector<unsigned char>& literales = flujos[0];
+    for (int k = 3; k < LZ_FLUJOS; ++k) {
+        if (flujos[k].size() != secuencias) return false;
+    }
+
+    size_t producidos = 0;
+    size_t leidos = 0;
+    size_t offsetLiterales = 0;
+    size_t offsetCopias = 0;
+    for (size_t i = 0; i < secuencias; ++i) {
+        size_t cantidad;
+        size_t largo;
+        if (!readLzLength(flujos[1], leidos, cantidad) || !readLzLength(flujos[2], offsetCopias, largo)) return false;
+        largo += LZ_MIN_MATCH;
+        size_t distancia = (size_t)flujos[3][i] | ((size_t)flujos[4][i] << 8) | ((size_t)flujos[5][i] << 16);
+
+        if (cantidad > literales.size() - offsetLiterales || cantidad > rawSize - producidos) return false;
+        if (cantidad > 0) memcpy(out + producidos, &literales[offsetLiterales], cantidad);
+        offsetLiterales += cantidad;
+        producidos += cantidad;
+
+        if (distancia == 0 || distancia > producidos || largo > rawSize - producidos) return false;
+        unsigned char* destino = out + producidos;
+        const unsigned char* origen = destino - distancia;
+        if (distancia >= largo) {
+            memcpy(destino, origen, largo);
+        }
+        else {
+            //la copia se superpone con lo que escribe (repeticion de un patron corto), va byte a byte
+            for (size_t k = 0; k < largo; ++k) destino[k] = origen[k];
+        }
+        producidos += largo;
+    }
+
+    //los literales que sobran completan el bloque
+    size_t resto = literales.size() - offsetLiterales;
+    if (resto != rawSize - producidos || leidos != flujos[1].size() || offsetCopias != flujos[2].size()) return false;
+    if (resto > 0) memcpy(out + producidos, &literales[offsetLiterales], resto);
+    return true;
+}
+
+//decodifica la parte codificada de un bloque lz77, desde su byte de modo, sin el crc
+bool decodeLzBlock(const unsigned char* encoded, size_t encodedSize, size_t rawSize, unsigned char* out, BlockDecoder& trabajo) {
+    size_t offset = 1;
+    size_t secuencias = readUInt(encoded, encodedSize, offset);
+    if (offset != 5 || secuencias > rawSize / LZ_MIN_MATCH) return false;
+
+    //cada flujo ocupa a lo sumo rawSize bytes: literales, largos de hasta 4 bytes por copia de al menos 4,
+    //y un byte de distancia por secuencia
+    for (int k = 0; k < LZ_FLUJOS; ++k) {
+        if (encodedSize - offset < 8) return false;
+        size_t tamano = readUInt(encoded, encodedSize, offset);
+        size_t codificado = readUInt(encoded, encodedSize, offset);
+        if (tamano > rawSize || codificado > encodedSize - offset) return false;
+        vector<unsigned char>& flujo = trabajo.flujos[k];
+        flujo.resize(tamano);
+        if (tamano > 0) {
+            if (codificado == 0 || encoded[offset] == BLOQUE_LZ77) return false;
+            if (!decodePlainBlock(encoded + offset, codificado, tamano, &flujo[0], trabajo.huffman, NULL, trabajo.stats)) return false;
+        }
+        else if (codificado != 0) {
+            return false;
+        }
+        offset += codificado;
+    }
+    if (offset != encodedSize) return false;
+    ScopedTimer timer(trabajo.stats, ETAPA_LZ77);
+    return rebuildLz77(trabajo.flujos, secuencias, out, rawSize);
+}
+
+//decodifica la parte codificada de un bloque en cualquiera de sus modos sobre out
+//trabajo conserva la tabla de decodificacion y los flujos lz77 entre bloques
+//el crc se calcula sobre out apenas se escribe, mientras el bloque sigue en la cache
+bool decodeBlock(const unsigned char* encoded, size_t encodedSize, size_t rawSize, unsigned char* out, BlockDecoder& trabajo, bool checksum) {
+    unsigned int esperado = 0;
+    if (checksum) {
+        if (encodedSize < 4) return false;
+        encodedSize -= 4;
+        size_t offset = encodedSize;
+        esperado = readUInt(encoded, encodedSize + 4, offset);
+    }
+
+    bool ok;
+    if (encodedSize > 0 && encoded[0] == BLOQUE_LZ77) {
+        ok = decodeLzBlock(encoded, encodedSize, rawSize, out, trabajo);
+    }
+    else if (encodedSize > 0 && encoded[0] == BLOQUE_TABLA_NUEVA) {
+        //la tabla del bloque queda vigente para los bloques con tabla externa que lo siguen
+        size_t offset;
+        ok = readNewTable(encoded, encodedSize, offset, trabajo) &&
+            decodeExternalStreams(encoded, encodedSize, offset, true, rawSize, out, trabajo.vigente, trabajo.stats);
+    }
+    else {
+        ok = decodePlainBlock(encoded, encodedSize, rawSize, out, trabajo.huffman, trabajo.tablaExterna, trabajo.stats);
+    }
+    if (ok && checksum) {
+        ScopedTimer timer(trabajo.stats, ETAPA_CRC);
+        ok = crc32c(out, rawSize, 0) == esperado;
+    }
+    if (ok && trabajo.stats) {
+        trabajo.stats->bloques[encoded[0]]++;
+        trabajo.stats->bytesOriginales += rawSize;
+        trabajo.stats->bytesCodificados += encodedSize + (checksum ? 4 : 0) + 8;
+    }
+    return ok;
+}
+
+//el id sale de las longitudes, y codigos y tabla del decodificador quedan armados para todos los mensajes
+bool buildDictionaryTables(Dictionary& diccionario) {
+    diccionario.id = crc32c(diccionario.lengths, 256, 0);
+    return buildCanonicalCodes(diccionario.lengths, diccionario.codigos) && buildDecoder(diccionario.codigos, diccionario.decoder);
+}
+
+bool buildDictionary(const unsigned long long freqs[256], int maxLongitud, Dictionary& diccionario) {
+    return buildCompleteLengths(freqs, maxLongitud, diccionario.lengths) && buildDictionaryTables(diccionario);
+}
+
+void saveDictionary(const Dictionary& diccionario, vector<unsigned char>& out) {
+    out.clear();
+    out.insert(out.end(), CPM_DICT_MAGIC, CPM_DICT_MAGIC + 4);
+    out.push_back(CPM_DICT_VERSION);
+    out.insert(out.end(), 3, 0);
+    appendUInt(out, diccionario.id);
+    appendCodeLengths(out, diccionario.lengths);
+    appendUInt(out, crc32c(&out[0], out.size(), 0));
+}
+
+bool loadDictionary(const unsigned char* data, size_t size, Dictionary& diccionario) {
+    if (size < 16 || memcmp(data, CPM_DICT_MAGIC, 4) != 0 || data[4] != CPM_DICT_VERSION) return false;
+    size_t offset = size - 4;
+    if (readUInt(data, size, offset) != crc32c(data, size - 4, 0)) return false;
+
+    offset = 8;
+    unsigned int id = readUInt(data, size, offset);
+    if (!readCodeLengths(data, size - 4, offset, diccionario.lengths) || offset != size - 4) return false;
+    //un id distinto de las longitudes indicaria un archivo armado a mano o danado
+    return buildDictionaryTables(diccionario) && diccionario.id == id;
+}
+
+bool trainDictionary(const vector<ByteSpan>& muestras, int maxLongitud, Dictionary& diccionario) {
+    unsigned long long freqs[256] = { 0 };
+    unsigned long long parcial[256];
+    for (size_t k = 0; k < muestras.size(); ++k) {
+        countFrequencies(muestras[k].data, muestras[k].size, parcial);
+        for (int i = 0; i < 256; ++i) freqs[i] += parcial[i];
+    }
+    return buildDictionary(freqs, maxLongitud, diccionario);
+}
+
+//comprime in como un .cpm v2 en memoria: header sin nombre, bloques de CPM_BLOCK_SIZE bytes y el cierre
+//el indice se omite porque en mensajes chicos pesaria mas que los datos; quien lo lea lo recorre en orden
+bool EncoderContext::compress(ByteSpan in, vector<unsigned char>& out) {
+    out.clear();
+    //con diccionario cada bloque tiene que poder elegir su tabla, sin la tabla vigente del modo de una pasada
+    if (opciones.diccionario && opciones.umbralTabla > 0) return false;
+    trabajo.tablaExterna = opciones.diccionario ? &opciones.diccionario->codigos : NULL;
+    appendFileHeader(out, "", CPM_BLOCK_SIZE, fileFlags(opciones), opciones.diccionario ? opciones.diccionario->id : 0);
+
+    //cada bloque se codifica directo al final de out, sin buffer intermedio
+    //en el modo de una pasada cada mensaje empieza sin tabla vigente
+    AdaptiveTable vigente;
+    BlockPlan plan;
+    for (size_t posicion = 0; posicion < in.size; posicion += CPM_BLOCK_SIZE) {
+        size_t tamano = min((size_t)CPM_BLOCK_SIZE, in.size - posicion);
+        bool ok;
+        if (opciones.umbralTabla > 0) {
+            planBlock(in.data + posicion, tamano, opciones, vigente, plan, trabajo.stats);
+            ok = encodePlannedBlock(in.data + posicion, tamano, plan, out, opciones, trabajo);
+        }
+        else {
+            ok = encodeBlock(in.data + posicion, tamano, out, opciones, trabajo);
+        }
+        if (!ok) return false;
+    }
+
+    appendUInt(out, 0);
+    appendUInt(out, 0);
+    appendULL(out, (unsigned long long)in.size);
+    return true;
+}
+
+//descomprime un .cpm v2 completo que esta en memoria
+//primero recorre los prefijos para conocer el tamano total y despues decodifica cada bloque en su lugar de out
+bool DecoderContext::decompress(ByteSpan in, vector<unsigned char>& out) {
+    out.clear();
+    if (in.size < CPM_HEADER_SIZE || memcmp(in.data, CPM_MAGIC, 4) != 0 || in.data[4] != CPM_VERSION) return false;
+    if ((in.data[5] & ~CPM_FLAGS_CONOCIDOS) != 0) return false;
+    bool checksum = (in.data[5] & CPM_FLAG_CRC32C) != 0;
+
+    size_t offset = 8;
+    unsigned int blockSize = readUInt(in.data, in.size, offset);
+    unsigned int nameLen = readUInt(in.data, in.size, offset);
+    if (blockSize == 0 || nameLen > in.size - offset) return false;
+    size_t inicioBloques = offset + nameLen;
+
+    //el diccionario del mensaje se busca entre los registrados; sus tablas ya estan armadas
+    const HuffmanDecoder* externa = NULL;
+    if (in.data[5] & CPM_FLAG_DICCIONARIO) {
+        if (in.size - inicioBloques < 4) return false;
+        offset = inicioBloques;
+        unsigned int id = readUInt(in.data, in.size, offset);
+        for (size_t k = 0; k < diccionarios.size() && !externa; ++k) {
+            if (diccionarios[k]->id == id) externa = &diccionarios[k]->decoder;
+        }
+        if (!externa) return false;
+        inicioBloques += 4;
+    }
+
+    //primera pasada: valida la estructura y suma los tamanos originales
+    unsigned long long total = 0;
+    offset = inicioBloques;
+    while (true) {
+        if (in.size - offset < 8) return false;
+        unsigned int rawSize = readUInt(in.data, in.size, offset);
+        unsigned int encodedSize = readUInt(in.data, in.size, offset);
+        if (rawSize == 0) break;
+        if (rawSize > blockSize || encodedSize > in.size - offset) return false;
+        offset += encodedSize;
+        total += rawSize;
+    }
+    if (in.size - offset < 8) return false;
+    unsigned long long declarado = 0;
+    for (int i = 0; i < 8; ++i) {
+        declarado |= (unsigned long long)in.data[offset + i] << (8 * i);
+    }
+    if (declarado != total || total > (size_t)-1) return false;
+
+    //segunda pasada: cada bloque se decodifica directo en su posicion final
+    //la tabla vigente de un mensaje anterior no vale para este
+    trabajo.tablaExterna = externa;
+    out.resize((size_t)total);
+    size_t escrito = 0;
+    offset = inicioBloques;
+    while (escrito < out.size()) {
+        unsigned int rawSize = readUInt(in.data, in.size, offset);
+        unsigned int encodedSize = readUInt(in.data, in.size, offset);
+        if (!decodeBlock(in.data + offset, encodedSize, rawSize, &out[escrito], trabajo, checksum)) {
+            out.clear();
+            return false;
+        }
+        offset += encodedSize;
+        escrito += rawSize;
+    }
+    return true;
+}
+
+bool compress(ByteSpan in, vector<unsigned char>& out, const CompressOptions& opciones) {
+    EncoderContext contexto(opciones);
+    return contexto.compress(in, out);
+}
+
+bool decompress(ByteSpan in, vector<unsigned char>& out, const Dictionary* diccionario) {
+    DecoderContext contexto;
+    if (diccionario) contexto.addDictionary(diccionario);
+    return contexto.decompress(in, out);
+}
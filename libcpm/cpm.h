@@ -0,0 +1,517 @@
+//libcpm: compresion huffman por bloques del formato .cpm, sobre buffers en memoria
+//no usa archivos, consola ni hilos propios; el programa de consola y otros servicios la enlazan igual
+#ifndef CPM_H
+#define CPM_H
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//estructura principal del arbol de huffman
+//los nodos viven en un arreglo fijo y se enlazan por indice, sin memoria dinamica
+struct HuffmanNodo {
+    //contador acumulado que indica cuantas veces aparece el simbolo asociado
+    unsigned long long frecuencia;
+    //identificador del byte almacenado en este nodo, -1 para nodos internos
+    int byteGuardado;
+    //indice del hijo izquierdo, asociado al bit 0 en el recorrido, -1 en las hojas
+    int izquierda;
+    //indice del hijo derecho, asociado al bit 1 en el recorrido, -1 en las hojas
+    int derecha;
+};
+
+//un arbol con 256 hojas tiene 255 nodos internos, 512 posiciones alcanzan siempre
+const int HUFFMAN_MAX_NODOS = 512;
+
+//arbol completo en un arreglo: primero las hojas ordenadas por frecuencia y luego los nodos internos
+//en el orden en que se crean, por eso cada nodo interno esta despues de sus dos hijos
+struct HuffmanArbol {
+    HuffmanNodo nodos[HUFFMAN_MAX_NODOS];
+    int cantidad;
+    //indice de la raiz, -1 si no hay simbolos
+    int raiz;
+};
+
+//longitud maxima de codigo que el escritor acepta en una sola llamada
+//con a lo sumo 7 bits pendientes el acumulador de 64 bits nunca se desborda
+//un bloque de hasta 4 GiB no puede generar codigos tan largos: una profundidad d exige
+//frecuencias que crecen como Fibonacci y suman mas de 2^32 antes de llegar a 48 niveles
+const int BIT_WRITER_MAX_BITS = 56;
+
+//codigos en forma numerica listos para el empaquetado, alineados a la derecha
+struct CodeTable {
+    unsigned long long bits[256];
+    unsigned char longitud[256];
+    //longitud del codigo mas largo de la tabla
+    int maxLongitud;
+};
+
+//longitud maxima de codigo por defecto: deja la tabla de longitudes en medios bytes y la perdida
+//frente al Huffman sin limite es despreciable
+const int DEFAULT_MAX_CODE_LENGTH = 15;
+//con 256 simbolos posibles ningun limite menor a 8 bits alcanza para asignar todos los codigos
+const int MIN_MAX_CODE_LENGTH = 8;
+
+//cantidad de flujos independientes del modo entrelazado
+const int CPM_FLUJOS = 4;
+
+//cantidad de bits que la tabla de decodificacion resuelve con una sola consulta
+//codigos mas largos continuan por el arbol plano bit a bit
+const int DECODE_TABLE_BITS = 11;
+//marca de entrada invalida: el prefijo no corresponde a ningun codigo conocido
+const unsigned short DECODE_INVALIDO = 0xFFFF;
+
+//nodo del arbol de decodificacion guardado en un arreglo plano
+struct DecodeNodo {
+    //indice de cada hijo dentro del arreglo, -1 cuando no existe
+    int hijos[2];
+    //byte representado por la hoja, -1 para nodos internos
+    int simbolo;
+};
+
+//entrada de la tabla indexada por los siguientes DECODE_TABLE_BITS bits
+struct DecodeEntrada {
+    //simbolo resuelto, o nodo desde donde sigue el camino lento cuando longitud es 0
+    unsigned short valor;
+    //bits que ocupa el codigo resuelto, 0 si el codigo es mas largo que la tabla
+    unsigned char longitud;
+};
+
+//estructuras que usa el decodificador para traducir bits a bytes sin cadenas intermedias
+struct HuffmanDecoder {
+    std::vector<DecodeNodo> nodos;
+    std::vector<DecodeEntrada> tabla;
+};
+
+//formatos de la tabla de longitudes dentro de cada bloque v2
+//medios bytes: 256 longitudes de 4 bits (128 bytes), valido si ninguna supera 15
+const unsigned char TABLA_NIBBLES = 0;
+//bytes: 256 longitudes de un byte cada una
+const unsigned char TABLA_BYTES = 1;
+//lista: cantidad de simbolos usados y un par (simbolo, longitud) por cada uno, conveniente con pocos simbolos
+const unsigned char TABLA_LISTA = 2;
+
+//formato v2: header con identificador y version, seguido de bloques independientes
+//header : magic(4) version(1) flags(1) reservado(2) tamanoBloque(4) largoNombre(4) nombre
+//         y con CPM_FLAG_DICCIONARIO el id del diccionario(4)
+//bloque : tamanoOriginal(4) tamanoCodificado(4) y luego modo(1) con la parte codificada:
+//         modo 0, un flujo      : relleno(1) longitudes payload
+//         modo 1, cuatro flujos : longitudes tamanoFlujo(4) x 3 y los cuatro flujos seguidos
+//         modo 2, sin comprimir : los bytes originales
+//         modo 3, byte repetido : el unico valor del bloque(1)
+//         modo 4, lz77          : secuencias(4) y LZ_FLUJOS sub-bloques con el formato de un bloque
+//                                 (prefijo de tamanos, modo 0 a 3 y su parte codificada, o 0 0 si esta vacio)
+//         modo 5, tabla externa : flujos(1) y luego relleno(1) payload si es 1, o tamanoFlujo(4) x 3 y los
+//                                 cuatro flujos si es 4; los codigos vienen del contenedor (tabla compartida)
+//                                 o, en un .cpm con CPM_FLAG_TABLA_VIGENTE, del ultimo bloque de modo 6,
+//                                 o con CPM_FLAG_DICCIONARIO del diccionario indicado en el header
+//         modo 6, tabla nueva   : longitudes flujos(1) y luego lo mismo que el modo 5, o los bytes originales
+//                                 si flujos es 0; sus longitudes pasan a ser la tabla vigente
+//         las longitudes alcanzan para reconstruir los codigos porque se asignan en forma canonica
+//         con el flag CPM_FLAG_CRC32C cada bloque termina con el crc32c(4) de sus bytes originales,
+//         incluido en tamanoCodificado
+//fin    : un bloque con tamanoOriginal 0 seguido del total de bytes originales(8)
+//indice : por bloque su posicion en el archivo(8), tamano comprimido(4) y tamano original(4),
+//         y al final posicionIndice(8) cantidadBloques(4) y el magic del indice(4)
+//el indice va despues del cierre para que una lectura secuencial pueda ignorarlo
+//un archivo v1 empieza con el relleno (0 a 7) como entero, por eso nunca coincide con el magic
+const unsigned char CPM_MAGIC[4] = { 'H', 'C', 'P', 'M' };
+const unsigned char CPM_VERSION = 2;
+//bytes originales por bloque, limita la memoria usada al comprimir y descomprimir
+const unsigned int CPM_BLOCK_SIZE = 1 << 20;
+//mayor tamano de bloque que se acepta al leer un header, para no reservar memoria por un valor danado
+const unsigned int CPM_MAX_BLOCK_SIZE = 1 << 26;
+//lo que un bloque codificado puede ocupar por encima de sus bytes originales: modo, la tabla de longitudes
+//mas larga (lista, un poco mas de 512 bytes), cantidad de flujos y crc, con margen; el codificador nunca lo supera
+//porque guarda los bytes tal cual cuando los codigos no achican el bloque
+const unsigned int CPM_MAX_BLOCK_OVERHEAD = 1024;
+//tamano de la parte fija del header v2, antes del nombre
+const size_t CPM_HEADER_SIZE = 16;
+
+//diccionario (.cpd): tabla de codigos entrenada con mensajes de muestra, para que los mensajes chicos
+//no tengan que guardar la suya
+//archivo : magic(4) version(1) reservado(3) id(4) longitudes (mismo formato que en un bloque) crc32c(4)
+//el id es el crc32c de las 256 longitudes, asi el mismo entrenamiento da siempre el mismo id
+const unsigned char CPM_DICT_MAGIC[4] = { 'H', 'C', 'P', 'T' };
+const unsigned char CPM_DICT_VERSION = 1;
+
+const unsigned char CPM_INDEX_MAGIC[4] = { 'H', 'C', 'P', 'I' };
+//flags del header: cada bloque lleva el crc32c de sus bytes originales
+const unsigned char CPM_FLAG_CRC32C = 1;
+//los bloques de modo 5 usan la tabla del ultimo bloque de modo 6: ya no se decodifican sueltos
+const unsigned char CPM_FLAG_TABLA_VIGENTE = 2;
+//los bloques de modo 5 usan la tabla de un diccionario externo, cuyo id va en el header
+const unsigned char CPM_FLAG_DICCIONARIO = 4;
+//flags que esta version sabe leer; un archivo con otros flags se rechaza en lugar de decodificarse mal
+const unsigned char CPM_FLAGS_CONOCIDOS = CPM_FLAG_CRC32C | CPM_FLAG_TABLA_VIGENTE | CPM_FLAG_DICCIONARIO;
+//modos de codificacion de cada bloque
+const unsigned char BLOQUE_UN_FLUJO = 0;
+const unsigned char BLOQUE_CUATRO_FLUJOS = 1;
+//cuando huffman no achica el bloque, y cuando el bloque es un solo byte repetido
+const unsigned char BLOQUE_SIN_COMPRIMIR = 2;
+const unsigned char BLOQUE_REPETIDO = 3;
+//secuencias lz77 (literales y copias del texto anterior) repartidas en flujos de bytes, cada uno con huffman
+const unsigned char BLOQUE_LZ77 = 4;
+//huffman con una tabla de codigos que no viaja en el bloque, compartida por varios bloques
+const unsigned char BLOQUE_TABLA_EXTERNA = 5;
+//huffman con una tabla armada desde una muestra, que queda vigente para los bloques siguientes
+const unsigned char BLOQUE_TABLA_NUEVA = 6;
+
+//etapa lz77: cada secuencia copia sus literales y despues largo bytes que ya aparecieron distancia bytes atras
+//flujos de una secuencia: literales, largo de literales, largo de la copia, y la distancia en tres bytes
+//(bajo, medio y alto) para que cada byte tenga su propia tabla de codigos
+const int LZ_FLUJOS = 6;
+//coincidencia mas corta que se codifica como copia
+const int LZ_MIN_MATCH = 4;
+//niveles de busqueda: 0 desactiva lz77, 1 es el mas rapido y LZ_NIVEL_MAXIMO el que mas comprime
+const int LZ_NIVEL_MAXIMO = 9;
+//ventana en bits: distancia maxima de una copia, nunca mas alla del inicio del bloque
+const int LZ_VENTANA_MIN = 10;
+const int LZ_VENTANA_MAX = 20;
+const int LZ_VENTANA_DEFECTO = 16;
+//por debajo de este tamano los tamanos de flujo extra no se compensan y se usa un solo flujo
+const size_t FOUR_STREAM_MIN_SIZE = 1024;
+//tamano del pie que cierra el indice al final del archivo
+const size_t CPM_FOOTER_SIZE = 16;
+//bytes que ocupa cada entrada del indice
+const size_t CPM_INDEX_ENTRY_SIZE = 16;
+
+//entrada del indice de bloques guardado al final del archivo
+struct BlockIndexEntry {
+    //posicion del bloque (desde su prefijo de tamanos) dentro del .cpm
+    unsigned long long offset;
+    //bytes que ocupa el bloque completo en el .cpm, prefijo incluido
+    unsigned int compressedSize;
+    unsigned int rawSize;
+};
+
+//datos del header v2 que se recuperan antes de procesar los bloques
+struct CpmHeader {
+    unsigned char version;
+    unsigned char flags;
+    unsigned int blockSize;
+    std::string originalName;
+    //id del diccionario con CPM_FLAG_DICCIONARIO, 0 sin el
+    unsigned int diccionario;
+};
+
+//tabla de codigos compartida por muchos mensajes; los codigos y la tabla del decodificador se arman
+//una sola vez al entrenarla o cargarla, y despues cada mensaje la usa sin reconstruir nada
+struct Dictionary {
+    unsigned int id;
+    unsigned char lengths[256];
+    CodeTable codigos;
+    HuffmanDecoder decoder;
+};
+
+//parametros de compresion que se pueden ajustar desde la linea de comandos o al crear un EncoderContext
+struct CompressOptions {
+    //cantidad de hilos del programa, 0 o negativo usa todos los nucleos (la biblioteca no crea hilos)
+    int hilos;
+    //longitud maxima permitida para cada codigo
+    int maxLongitud;
+    //flujos de bits por bloque: 4 permite decodificar en paralelo dentro del bloque, 1 es el formato simple
+    int flujos;
+    //nivel de la etapa lz77, 0 la desactiva
+    int nivelLz;
+    //bits de la ventana lz77
+    int ventanaLz;
+    //guarda el crc32c de cada bloque para detectar datos danados al descomprimir
+    bool checksum;
+    //modo de una pasada: la tabla sale de una muestra del bloque y se reutiliza mientras la muestra no
+    //ocupe mas de este porcentaje por encima de una tabla propia; 0 lo desactiva (y lz77 no se usa en este modo)
+    int umbralTabla;
+    //tabla que prueba cada bloque antes de armar la suya, NULL para no usar diccionario;
+    //no se combina con umbralTabla y debe seguir existiendo mientras se comprime
+    const Dictionary* diccionario;
+
+    CompressOptions()
+        : hilos(1), maxLongitud(DEFAULT_MAX_CODE_LENGTH), flujos(CPM_FLUJOS), nivelLz(0), ventanaLz(LZ_VENTANA_DEFECTO),
+          checksum(true), umbralTabla(0), diccionario(NULL) {
+    }
+};
+
+//etapas del codec que se miden por separado
+enum CpmEtapa {
+    //conteo de frecuencias de cada bloque (y de cada flujo lz77)
+    ETAPA_HISTOGRAMA,
+    //busqueda de coincidencias al comprimir, reconstruccion de las copias al descomprimir
+    ETAPA_LZ77,
+    //arbol, longitudes y codigos canonicos
+    ETAPA_ARBOL,
+    //empaquetado de los codigos en bits, o copia de bloques sin comprimir
+    ETAPA_CODIFICACION,
+    //lectura de la tabla de longitudes de cada bloque y armado de la tabla del decodificador
+    ETAPA_TABLAS,
+    //traduccion de bits a bytes
+    ETAPA_DECODIFICACION,
+    //crc32c de cada bloque
+    ETAPA_CRC,
+    //lectura y escritura de archivos o flujos: la biblioteca no las usa, las mide quien hace la entrada y salida
+    ETAPA_LECTURA,
+    ETAPA_ESCRITURA,
+    CPM_ETAPAS
+};
+
+//nombres de las etapas para mostrarlas o guardarlas en json, en el orden de CpmEtapa
+const char* const CPM_NOMBRES_ETAPAS[CPM_ETAPAS] = {
+    "histograma", "lz77", "arbol", "codificacion", "tablas", "decodificacion", "crc", "lectura", "escritura"
+};
+
+//cantidad de modos de bloque distintos, de BLOQUE_UN_FLUJO a BLOQUE_TABLA_NUEVA
+const int CPM_MODOS = BLOQUE_TABLA_NUEVA + 1;
+
+//tiempos por etapa y contadores de bloques; cada hilo o contexto usa el suyo y despues se suman
+struct CodecStats {
+    unsigned long long nanos[CPM_ETAPAS];
+    //bloques por modo, sin contar los flujos internos de un bloque lz77
+    unsigned long long bloques[CPM_MODOS];
+    //bytes originales y bytes que ocupan esos bloques en el .cpm, prefijo y crc incluidos
+    unsigned long long bytesOriginales;
+    unsigned long long bytesCodificados;
+    //bytes que pasaron por el codigo huffman (tambien dentro de los flujos lz77)
+    unsigned long long simbolos;
+
+    CodecStats() {
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < CPM_ETAPAS; ++i) nanos[i] = 0;
+        for (int i = 0; i < CPM_MODOS; ++i) bloques[i] = 0;
+        bytesOriginales = bytesCodificados = simbolos = 0;
+    }
+
+    void add(const CodecStats& otro) {
+        for (int i = 0; i < CPM_ETAPAS; ++i) nanos[i] += otro.nanos[i];
+        for (int i = 0; i < CPM_MODOS; ++i) bloques[i] += otro.bloques[i];
+        bytesOriginales += otro.bytesOriginales;
+        bytesCodificados += otro.bytesCodificados;
+        simbolos += otro.simbolos;
+    }
+};
+
+//suma a una etapa el tiempo que dura su alcance; con stats NULL no lee el reloj, asi medir
+//apagado no cuesta mas que una comparacion
+class ScopedTimer {
+public:
+    ScopedTimer(CodecStats* stats, CpmEtapa etapa) : stats(stats), etapa(etapa) {
+        if (stats) inicio = std::chrono::steady_clock::now();
+    }
+
+    ~ScopedTimer() {
+        if (stats) {
+            stats->nanos[etapa] += (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now() - inicio).count();
+        }
+    }
+
+private:
+    CodecStats* stats;
+    CpmEtapa etapa;
+    std::chrono::steady_clock::time_point inicio;
+
+    ScopedTimer(const ScopedTimer&);
+    ScopedTimer& operator=(const ScopedTimer&);
+};
+
+//memoria de trabajo del compresor, se reutiliza entre bloques para no reservarla cada vez
+//un mismo objeto no se usa desde dos hilos al mismo tiempo
+struct BlockEncoder {
+    //ultima posicion vista para cada hash de 4 bytes
+    std::vector<int> cabeza;
+    //posicion anterior con el mismo hash, indexada por posicion dentro de la ventana
+    std::vector<int> previo;
+    //flujos de las secuencias lz77 antes de codificarlos
+    std::vector<unsigned char> flujos[LZ_FLUJOS];
+    //tabla compartida que se prueba antes de construir una propia, NULL si no hay; el bloque
+    //la usa (modo BLOQUE_TABLA_EXTERNA) solo si cubre todos sus bytes y ocupa menos
+    const CodeTable* tablaExterna;
+    //donde se acumulan los tiempos de cada etapa, NULL para no medir
+    CodecStats* stats;
+
+    BlockEncoder() : tablaExterna(NULL), stats(NULL) {
+    }
+};
+
+//memoria de trabajo del descompresor, se reutiliza entre bloques
+struct BlockDecoder {
+    HuffmanDecoder huffman;
+    //flujos lz77 ya decodificados
+    std::vector<unsigned char> flujos[LZ_FLUJOS];
+    //tabla ya armada para los bloques con tabla externa, la misma que uso el compresor
+    const HuffmanDecoder* tablaExterna;
+    //tabla del ultimo bloque de modo 6, al que apunta tablaExterna despues de leerlo
+    HuffmanDecoder vigente;
+    CodecStats* stats;
+
+    BlockDecoder() : tablaExterna(NULL), stats(NULL) {
+    }
+};
+
+//tabla que el modo de una pasada va reutilizando de un bloque al siguiente
+struct AdaptiveTable {
+    CodeTable codigos;
+    unsigned char lengths[256];
+    bool valida;
+
+    AdaptiveTable() : valida(false) {
+    }
+};
+
+//como se codifica un bloque en el modo de una pasada
+enum PlanBloque {
+    PLAN_SIN_COMPRIMIR,
+    PLAN_REPETIDO,
+    PLAN_TABLA_VIGENTE,
+    PLAN_TABLA_NUEVA
+};
+
+//decision tomada sobre un bloque antes de codificarlo, con la tabla que le toca
+struct BlockPlan {
+    PlanBloque tipo;
+    AdaptiveTable tabla;
+};
+
+
+//piezas del codec, compartidas con el programa de consola
+//arbol y codigos
+void buildHuffmanTree(const unsigned long long freqs[256], HuffmanArbol& arbol);
+void buildCodeLengths(const HuffmanArbol& arbol, unsigned char lengths[256]);
+bool buildCanonicalCodes(const unsigned char lengths[256], CodeTable& tabla);
+void limitCodeLengths(const unsigned long long freqs[256], int maxLongitud, unsigned char lengths[256]);
+//arbol, longitudes y limite en un paso: las longitudes que usa cada bloque, o una tabla compartida
+bool buildLimitedLengths(const unsigned long long freqs[256], int maxLongitud, unsigned char lengths[256]);
+bool buildCodeTable(const std::vector<std::string>& codes, CodeTable& tabla);
+void countFrequencies(const unsigned char* data, size_t size, unsigned long long freqs[256]);
+
+//crc32c (polinomio de Castagnoli) de data, continuando desde crc; el valor inicial es 0
+//usa la instruccion crc32 de sse4.2 cuando el procesador la tiene
+unsigned int crc32c(const unsigned char* data, size_t size, unsigned int crc);
+
+//decodificacion de un flujo de bits
+bool buildDecoder(const CodeTable& codes, HuffmanDecoder& dec);
+size_t decodeSymbols(const HuffmanDecoder& dec,
+    const unsigned char* data,
+    size_t size,
+    unsigned long long totalBits,
+    unsigned char* out,
+    size_t maxSymbols);
+
+//enteros little endian y tablas de longitudes
+unsigned int readUInt(const unsigned char* data, size_t size, size_t& offset);
+unsigned int readUInt(const std::vector<unsigned char>& data, size_t& offset);
+unsigned long long readULL(const std::vector<unsigned char>& data, size_t& offset);
+void appendUInt(std::vector<unsigned char>& data, unsigned int value);
+void appendULL(std::vector<unsigned char>& data, unsigned long long value);
+void appendCodeLengths(std::vector<unsigned char>& out, const unsigned char lengths[256]);
+bool readCodeLengths(const unsigned char* data, size_t size, size_t& offset, unsigned char lengths[256]);
+
+//contenedor v2 y bloques
+//diccionario es el id que se guarda si flags incluye CPM_FLAG_DICCIONARIO
+void appendFileHeader(std::vector<unsigned char>& out,
+    const std::string& originalName,
+    unsigned int blockSize,
+    unsigned char flags,
+    unsigned int diccionario);
+void appendBlockIndex(std::vector<unsigned char>& out, const std::vector<BlockIndexEntry>& indice, unsigned long long indexOffset);
+bool encodeBlock(const unsigned char* data, size_t size, std::vector<unsigned char>& block, const CompressOptions& opciones, BlockEncoder& trabajo);
+//flags del header que corresponden a las opciones
+unsigned char fileFlags(const CompressOptions& opciones);
+//modo de una pasada: planBlock decide con una muestra si el bloque reutiliza la tabla vigente o arma una nueva
+//(y la deja vigente); se llama en el orden de los bloques, y encodePlannedBlock puede ir despues en cualquier hilo
+void planBlock(const unsigned char* data, size_t size, const CompressOptions& opciones, AdaptiveTable& vigente, BlockPlan& plan, CodecStats* stats);
+bool encodePlannedBlock(const unsigned char* data,
+    size_t size,
+    const BlockPlan& plan,
+    std::vector<unsigned char>& block,
+    const CompressOptions& opciones,
+    BlockEncoder& trabajo);
+//con checksum el bloque termina en el crc32c de los datos originales y se rechaza si no coincide
+bool decodeBlock(const unsigned char* encoded, size_t encodedSize, size_t rawSize, unsigned char* out, BlockDecoder& trabajo, bool checksum);
+//deja vigente la tabla de la parte codificada de un bloque de modo 6, para decodificar un bloque de modo 5
+//sin haber pasado por los anteriores
+bool loadBlockTable(const unsigned char* encoded, size_t encodedSize, BlockDecoder& trabajo);
+
+//diccionarios
+//arma el diccionario con frecuencias ya sumadas: todos los bytes reciben codigo, tambien los que no
+//aparecieron, asi cualquier mensaje puede usarlo
+bool buildDictionary(const unsigned long long freqs[256], int maxLongitud, Dictionary& diccionario);
+void saveDictionary(const Dictionary& diccionario, std::vector<unsigned char>& out);
+//valida el archivo completo (magic, version, crc e id) y arma las tablas
+bool loadDictionary(const unsigned char* data, size_t size, Dictionary& diccionario);
+
+//interfaz en memoria
+//vista de solo lectura sobre bytes ajenos, cumple el papel de std::span<const unsigned char>
+struct ByteSpan {
+    const unsigned char* data;
+    size_t size;
+
+    ByteSpan() : data(NULL), size(0) {
+    }
+
+    ByteSpan(const unsigned char* datos, size_t tamano) : data(datos), size(tamano) {
+    }
+
+    ByteSpan(const std::vector<unsigned char>& datos) : data(datos.empty() ? NULL : &datos[0]), size(datos.size()) {
+    }
+};
+
+//compresor reutilizable: cada llamada deja en out un .cpm v2 completo, sin nombre ni indice
+//out se vacia y se vuelve a llenar, por lo que reutilizar el mismo buffer evita reservar memoria
+//las tablas de cada bloque viven en la pila y la memoria de lz77 se conserva entre llamadas
+//un contexto no se comparte entre hilos al mismo tiempo; cada hilo usa el suyo
+class EncoderContext {
+public:
+    EncoderContext() {
+    }
+
+    explicit EncoderContext(const CompressOptions& opciones) : opciones(opciones) {
+    }
+
+    bool compress(ByteSpan in, std::vector<unsigned char>& out);
+
+    const CompressOptions& options() const {
+        return opciones;
+    }
+
+    //acumula en stats el tiempo de cada etapa de las llamadas siguientes, NULL deja de medir
+    void setStats(CodecStats* stats) {
+        trabajo.stats = stats;
+    }
+
+private:
+    CompressOptions opciones;
+    BlockEncoder trabajo;
+};
+
+//descompresor reutilizable: conserva el arbol y la tabla de decodificacion entre llamadas,
+//asi despues de la primera llamada solo se reserva memoria si out necesita crecer
+//acepta cualquier .cpm v2, con o sin nombre e indice; un contexto no se comparte entre hilos
+class DecoderContext {
+public:
+    bool decompress(ByteSpan in, std::vector<unsigned char>& out);
+
+    void setStats(CodecStats* stats) {
+        trabajo.stats = stats;
+    }
+
+    //diccionario disponible para los mensajes que lo indiquen por su id; no se copia, debe seguir existiendo
+    void addDictionary(const Dictionary* diccionario) {
+        diccionarios.push_back(diccionario);
+    }
+
+private:
+    BlockDecoder trabajo;
+    std::vector<const Dictionary*> diccionarios;
+};
+
+//entrena un diccionario con mensajes de muestra, sumando las frecuencias de todos
+bool trainDictionary(const std::vector<ByteSpan>& muestras, int maxLongitud, Dictionary& diccionario);
+
+//atajos de una sola llamada, crean un contexto temporal
+bool compress(ByteSpan in, std::vector<unsigned char>& out, const CompressOptions& opciones = CompressOptions());
+bool decompress(ByteSpan in, std::vector<unsigned char>& out, const Dictionary* diccionario = NULL);
+
+#endif